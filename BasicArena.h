@@ -0,0 +1,72 @@
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+
+#include "types.h"
+
+// Linear with a fixed capacity and alignment known at compile time. the memory is a std::array
+// inside the arena, so it needs no init and no malloc and can live on the stack or in static
+// storage. every allocation is rounded up to Alignment, which keeps the offset aligned and turns
+// alloc into a compare and an add. free is a no-op, memory comes back with reset or rollbackTo
+template <size_t Capacity, size_t Alignment = MIN_ALIGNMENT>
+struct BasicArena {
+    static_assert(Alignment != 0 && (Alignment & (Alignment - 1)) == 0, "alignment must be a power of 2");
+    static_assert(Capacity % Alignment == 0, "capacity must be a multiple of the alignment");
+
+    alignas(Alignment) std::array<uint8_t, Capacity> memory;
+    size_t offset = 0;
+
+    BasicArena() = default;
+    BasicArena(const BasicArena&) = delete;
+    BasicArena& operator=(const BasicArena&) = delete;
+};
+
+template <size_t Capacity, size_t Alignment>
+void* alloc(BasicArena<Capacity, Alignment>& arena, size_t size, size_t alignment = Alignment) {
+    assert((alignment & (alignment - 1)) == 0 && "alignment must be a power of 2");
+
+    size_t start = arena.offset;
+    if (alignment > Alignment) {
+        // only stricter requests pay for aligning the address
+        uintptr_t base = (uintptr_t) arena.memory.data();
+        start = ((base + start + alignment - 1) & ~(alignment - 1)) - base;
+    }
+
+    size_t rounded = (size + Alignment - 1) & ~(Alignment - 1);
+    if (rounded < size || start > Capacity || rounded > Capacity - start) return nullptr;
+
+    arena.offset = start + rounded;
+    return arena.memory.data() + start;
+}
+
+template <size_t Capacity, size_t Alignment>
+void free(BasicArena<Capacity, Alignment>&, void*) {}
+
+template <size_t Capacity, size_t Alignment>
+void reset(BasicArena<Capacity, Alignment>& arena) {
+    arena.offset = 0;
+}
+
+// a marker is just the offset
+template <size_t Capacity, size_t Alignment>
+size_t getMarker(const BasicArena<Capacity, Alignment>& arena) {
+    return arena.offset;
+}
+
+template <size_t Capacity, size_t Alignment>
+void rollbackTo(BasicArena<Capacity, Alignment>& arena, size_t marker) {
+    assert(marker <= arena.offset && "marker is ahead of the arena");
+    arena.offset = marker;
+}
+
+template <size_t Capacity, size_t Alignment>
+size_t getUsed(const BasicArena<Capacity, Alignment>& arena) {
+    return arena.offset;
+}
+
+template <size_t Capacity, size_t Alignment>
+size_t getAvailable(const BasicArena<Capacity, Alignment>& arena) {
+    return Capacity - arena.offset;
+}
@@ -0,0 +1,333 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+
+#include "FreeListAllocator.h"
+#include "types.h"
+
+// FreeList with its parameters fixed at compile time, for heaps that always allocate the same way.
+// Policy (see FreeListPolicy) picks the fit policy, the alignment every block gets and the
+// arena capacity, all constexpr, so the unused policy and the padding math compile away:
+//
+//   - every payload is Policy::alignment aligned, blocks need no front padding and the header
+//     is one size + flags word at ptr - 8. block sizes are multiples of the alignment
+//   - with Policy::capacity != 0 the arena is a std::array inside the allocator and never
+//     touches malloc, so the whole heap can sit on the stack or in static storage
+//
+// blocks coalesce through boundary tags exactly like FreeList. larger alignments than the
+// policy's still work, alloc then splits the gap in front off as a free block.
+// the free lists point into the arena, so an initialized allocator can't be copied or moved
+
+template <FreeList::FitPolicy Fit = FreeList::FitPolicy::FirstFit, size_t Alignment = MIN_ALIGNMENT, size_t Capacity = 0>
+struct FreeListPolicy {
+    static constexpr FreeList::FitPolicy fit = Fit;
+    static constexpr size_t alignment = Alignment;
+    static constexpr size_t capacity = Capacity; // 0: init takes a size and mallocs the arena
+};
+
+namespace BasicDetail {
+    template <size_t Capacity, size_t Alignment>
+    struct InlineStorage {
+        alignas(Alignment) std::array<uint8_t, Capacity> bytes;
+
+        uint8_t* data() { return bytes.data(); }
+        size_t size() const { return Capacity; }
+    };
+
+    struct HeapStorage {
+        uint8_t* memory = nullptr;
+        size_t capacity = 0;
+
+        uint8_t* data() { return memory; }
+        size_t size() const { return capacity; }
+    };
+}
+
+template <typename Policy>
+struct BasicFreeList {
+    static constexpr size_t ALIGNMENT = Policy::alignment;
+    static_assert(ALIGNMENT >= MIN_ALIGNMENT && (ALIGNMENT & (ALIGNMENT - 1)) == 0, "alignment must be a power of 2 and at least MIN_ALIGNMENT");
+
+    static constexpr bool INLINE = Policy::capacity != 0;
+    static constexpr bool SEGREGATED = Policy::fit == FreeList::FitPolicy::Segregated;
+    static_assert(SEGREGATED || Policy::fit == FreeList::FitPolicy::FirstFit, "BasicFreeList only implements FirstFit and Segregated");
+    static constexpr size_t HEADER = sizeof(size_t);
+    static constexpr size_t MIN_BLOCK = (MIN_BLOCK_SIZE + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+
+    std::conditional_t<INLINE, BasicDetail::InlineStorage<Policy::capacity, ALIGNMENT>, BasicDetail::HeapStorage> storage;
+    Node* free_list = nullptr; // FirstFit
+    uint64_t bin_bitmap = 0;   // Segregated, same bins as FreeList
+    Node* bins[FreeList::BIN_COUNT] = {};
+
+    BasicFreeList() = default;
+    BasicFreeList(const BasicFreeList&) = delete;
+    BasicFreeList& operator=(const BasicFreeList&) = delete;
+};
+
+namespace BasicDetail {
+    const size_t BLOCK_USED = 1 << 0;
+    const size_t BLOCK_PREV_FREE = 1 << 1;
+    const size_t BLOCK_FLAGS = BLOCK_USED | BLOCK_PREV_FREE;
+
+    inline size_t& tag(void* block) {
+        return *(size_t*) block;
+    }
+
+    inline size_t block_size(void* block) {
+        return tag(block) & ~BLOCK_FLAGS;
+    }
+
+    inline bool is_used(void* block) {
+        return tag(block) & BLOCK_USED;
+    }
+
+    inline void write_footer(Node* node) {
+        *(size_t*) ((uint8_t*) node + block_size(node) - sizeof(size_t)) = block_size(node);
+    }
+
+    // same classes as FreeList's bins
+    constexpr size_t bin_index(size_t physical) {
+        if (physical < FreeList::SMALL_BIN_LIMIT) return physical / MIN_ALIGNMENT;
+        return std::min(FreeList::SMALL_BIN_COUNT + (63 - __builtin_clzll(physical)) - 8, FreeList::BIN_COUNT - 1);
+    }
+
+    // physical size of a block that holds size bytes, constant folded for constant sizes.
+    // wraps around for sizes near SIZE_MAX, callers refuse anything smaller than size
+    template <typename Policy>
+    constexpr size_t block_for(size_t size) {
+        using Heap = BasicFreeList<Policy>;
+        return std::max(Heap::MIN_BLOCK, (Heap::HEADER + size + Heap::ALIGNMENT - 1) & ~(Heap::ALIGNMENT - 1));
+    }
+
+    template <typename Policy>
+    Node*& list_head(BasicFreeList<Policy>& heap, size_t size) {
+        if constexpr (BasicFreeList<Policy>::SEGREGATED) return heap.bins[bin_index(size)];
+        else return heap.free_list;
+    }
+
+    template <typename Policy>
+    void insert_free_block(BasicFreeList<Policy>& heap, Node* node) {
+        Node*& head = list_head(heap, block_size(node));
+        node->prev = nullptr;
+        node->next = head;
+        if (head != nullptr) head->prev = node;
+        head = node;
+        if constexpr (BasicFreeList<Policy>::SEGREGATED) heap.bin_bitmap |= (uint64_t)1 << bin_index(block_size(node));
+    }
+
+    template <typename Policy>
+    void remove_free_block(BasicFreeList<Policy>& heap, Node* node) {
+        Node*& head = list_head(heap, block_size(node));
+        if (node->prev != nullptr) node->prev->next = node->next;
+        else head = node->next;
+        if (node->next != nullptr) node->next->prev = node->prev;
+        if constexpr (BasicFreeList<Policy>::SEGREGATED) {
+            if (head == nullptr) heap.bin_bitmap &= ~((uint64_t)1 << bin_index(block_size(node)));
+        }
+    }
+
+    // the span at node (its tag holds BLOCK_PREV_FREE if that applies) becomes free, merged with its neighbours
+    template <typename Policy>
+    void release_block(BasicFreeList<Policy>& heap, Node* node, size_t size) {
+        uint8_t* next = (uint8_t*) node + size;
+        if (!is_used(next)) {
+            remove_free_block(heap, (Node*) next);
+            size += block_size(next);
+        }
+        if (tag(node) & BLOCK_PREV_FREE) {
+            Node* prev = (Node*) ((uint8_t*) node - *((size_t*) node - 1));
+            remove_free_block(heap, prev);
+            size += block_size(prev);
+            node = prev;
+        }
+
+        node->block_size = size;
+        write_footer(node);
+        tag((uint8_t*) node + size) |= BLOCK_PREV_FREE;
+        insert_free_block(heap, node);
+    }
+
+    // the free block at node (already out of the lists) becomes a used block of needed bytes
+    template <typename Policy>
+    void* carve(BasicFreeList<Policy>& heap, Node* node, size_t needed) {
+        size_t available = block_size(node);
+        if (available - needed >= BasicFreeList<Policy>::MIN_BLOCK) {
+            Node* rest = (Node*) ((uint8_t*) node + needed);
+            rest->block_size = available - needed;
+            write_footer(rest);
+            insert_free_block(heap, rest);
+        } else {
+            needed = available;
+            tag((uint8_t*) node + needed) &= ~BLOCK_PREV_FREE;
+        }
+
+        tag(node) = needed | BLOCK_USED | (tag(node) & BLOCK_PREV_FREE);
+        return (uint8_t*) node + BasicFreeList<Policy>::HEADER;
+    }
+
+    // bytes to split off the front of node so its payload lands on alignment, 0 or at least MIN_BLOCK
+    template <typename Policy>
+    size_t front_gap(Node* node, size_t alignment) {
+        uintptr_t payload = (uintptr_t) node + BasicFreeList<Policy>::HEADER;
+        size_t gap = (alignment - (payload & (alignment - 1))) & (alignment - 1);
+        while (gap != 0 && gap < BasicFreeList<Policy>::MIN_BLOCK) gap += alignment;
+        return gap;
+    }
+
+    template <typename Policy>
+    bool fits(Node* node, size_t needed, size_t alignment) {
+        if (alignment <= BasicFreeList<Policy>::ALIGNMENT) return block_size(node) >= needed;
+        return block_size(node) >= front_gap<Policy>(node, alignment) + needed;
+    }
+
+    template <typename Policy>
+    Node* find(BasicFreeList<Policy>& heap, size_t needed, size_t alignment) {
+        if constexpr (BasicFreeList<Policy>::SEGREGATED) {
+            uint64_t candidates = heap.bin_bitmap & (~(uint64_t)0 << bin_index(needed));
+            for (; candidates != 0; candidates &= candidates - 1) {
+                for (Node* curr = heap.bins[__builtin_ctzll(candidates)]; curr != nullptr; curr = curr->next) {
+                    if (fits<Policy>(curr, needed, alignment)) return curr;
+                }
+            }
+        } else {
+            for (Node* curr = heap.free_list; curr != nullptr; curr = curr->next) {
+                if (fits<Policy>(curr, needed, alignment)) return curr;
+            }
+        }
+        return nullptr;
+    }
+
+    template <typename Policy>
+    bool build(BasicFreeList<Policy>& heap) {
+        using Heap = BasicFreeList<Policy>;
+        heap.free_list = nullptr;
+        heap.bin_bitmap = 0;
+        std::fill(heap.bins, heap.bins + FreeList::BIN_COUNT, nullptr);
+
+        // blocks start HEADER bytes before an aligned address, so every payload is aligned
+        uintptr_t memory = (uintptr_t) heap.storage.data();
+        uintptr_t first = ((memory + Heap::HEADER + Heap::ALIGNMENT - 1) & ~(Heap::ALIGNMENT - 1)) - Heap::HEADER;
+        uintptr_t end = memory + heap.storage.size() - sizeof(size_t); // last word that can hold the sentinel
+        if (end < first || end - first < Heap::MIN_BLOCK) return false;
+
+        size_t span = (end - first) & ~(Heap::ALIGNMENT - 1);
+        tag((void*) (first + span)) = BLOCK_USED;
+
+        Node* node = (Node*) first;
+        node->block_size = span;
+        release_block(heap, node, span);
+        return true;
+    }
+}
+
+// arena inside the allocator (Policy::capacity != 0)
+template <typename Policy>
+bool init(BasicFreeList<Policy>& heap) {
+    static_assert(BasicFreeList<Policy>::INLINE, "heap backed BasicFreeList needs init(heap, size)");
+    return BasicDetail::build(heap);
+}
+
+// arena from malloc (Policy::capacity == 0)
+template <typename Policy>
+bool init(BasicFreeList<Policy>& heap, size_t total_size) {
+    static_assert(!BasicFreeList<Policy>::INLINE, "inline BasicFreeList has a fixed capacity, use init(heap)");
+    heap.storage.memory = (uint8_t*) std::malloc(total_size);
+    if (heap.storage.memory == nullptr) return false;
+    heap.storage.capacity = total_size;
+
+    if (!BasicDetail::build(heap)) {
+        std::free(heap.storage.memory);
+        heap.storage.memory = nullptr;
+        heap.storage.capacity = 0;
+        return false;
+    }
+    return true;
+}
+
+template <typename Policy>
+void* alloc(BasicFreeList<Policy>& heap, size_t size, size_t alignment = Policy::alignment) {
+    size_t needed = BasicDetail::block_for<Policy>(size);
+    if (needed < size) return nullptr;
+    Node* node = BasicDetail::find(heap, needed, alignment);
+    if (node == nullptr) return nullptr;
+    BasicDetail::remove_free_block(heap, node);
+
+    if (alignment > Policy::alignment) {
+        size_t gap = BasicDetail::front_gap<Policy>(node, alignment);
+        if (gap != 0) {
+            // the gap stays free, its prev is used (or node would have merged with it)
+            size_t available = BasicDetail::block_size(node);
+            Node* front = node;
+            front->block_size = gap;
+            BasicDetail::write_footer(front);
+            BasicDetail::insert_free_block(heap, front);
+
+            node = (Node*) ((uint8_t*) front + gap);
+            BasicDetail::tag(node) = (available - gap) | BasicDetail::BLOCK_PREV_FREE;
+        }
+    }
+
+    return BasicDetail::carve(heap, node, needed);
+}
+
+template <typename Policy>
+void free(BasicFreeList<Policy>& heap, void* ptr) {
+    if (ptr == nullptr) return;
+
+    Node* node = (Node*) ((uint8_t*) ptr - BasicFreeList<Policy>::HEADER);
+    assert(BasicDetail::is_used(node) && "block already freed");
+    BasicDetail::release_block(heap, node, BasicDetail::block_size(node));
+}
+
+template <typename Policy>
+size_t usableSize(BasicFreeList<Policy>&, void* ptr) {
+    return BasicDetail::block_size((uint8_t*) ptr - BasicFreeList<Policy>::HEADER) - BasicFreeList<Policy>::HEADER;
+}
+
+// grows in place into a free next block when it can, otherwise moves (keeping Policy::alignment)
+template <typename Policy>
+void* realloc(BasicFreeList<Policy>& heap, void* ptr, size_t new_size) {
+    if (ptr == nullptr) return alloc(heap, new_size);
+    if (new_size == 0) {
+        free(heap, ptr);
+        return nullptr;
+    }
+
+    size_t old_size = usableSize(heap, ptr);
+    if (new_size <= old_size) return ptr;
+
+    Node* node = (Node*) ((uint8_t*) ptr - BasicFreeList<Policy>::HEADER);
+    uint8_t* next = (uint8_t*) node + BasicDetail::block_size(node);
+    size_t needed = BasicDetail::block_for<Policy>(new_size);
+    if (needed < new_size) return nullptr; // the block stays as it is
+    if (!BasicDetail::is_used(next) && BasicDetail::block_size(node) + BasicDetail::block_size(next) >= needed) {
+        BasicDetail::remove_free_block(heap, (Node*) next);
+        size_t prev_free = BasicDetail::tag(node) & BasicDetail::BLOCK_PREV_FREE;
+        BasicDetail::tag(node) = (BasicDetail::block_size(node) + BasicDetail::block_size(next)) | prev_free;
+        return BasicDetail::carve(heap, node, needed);
+    }
+
+    void* new_ptr = alloc(heap, new_size);
+    if (new_ptr == nullptr) return nullptr;
+    std::memcpy(new_ptr, ptr, old_size);
+    free(heap, ptr);
+    return new_ptr;
+}
+
+template <typename Policy>
+void destroy(BasicFreeList<Policy>& heap) {
+    if constexpr (!BasicFreeList<Policy>::INLINE) {
+        std::free(heap.storage.memory);
+        heap.storage.memory = nullptr;
+        heap.storage.capacity = 0;
+    }
+    heap.free_list = nullptr;
+    heap.bin_bitmap = 0;
+    std::fill(heap.bins, heap.bins + FreeList::BIN_COUNT, nullptr);
+}
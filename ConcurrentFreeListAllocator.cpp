@@ -0,0 +1,309 @@
+#include "ConcurrentFreeListAllocator.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstring>
+
+namespace ConcurrentFreeList {
+
+namespace {
+
+const uint32_t DIRECT_CLASS = UINT32_MAX; // block bypassed the caches
+
+// sits right before every pointer handed out
+struct BlockPrefix {
+    ThreadCache* owner;  // cache the block belongs to, nullptr when it bypassed the caches
+    uint32_t size_class;
+    uint32_t offset;     // distance from the central heap payload to the user pointer
+};
+
+// a cached block, the link lives in the (unused) user area
+struct CachedBlock {
+    CachedBlock* next;
+};
+
+}
+
+struct ThreadCache {
+    Allocator* allocator;
+    std::atomic<bool> detached; // allocator was destroyed, nothing in here may be touched anymore. set under caches_lock
+    std::atomic<bool> abandoned; // owning thread exited, frees go straight to the central heap
+    std::atomic<CachedBlock*> remote_frees; // pushed by other threads, drained by the owner
+
+    CachedBlock* bins[CLASS_COUNT];
+    size_t counts[CLASS_COUNT];
+};
+
+namespace {
+
+void abandon(ThreadCache& cache);
+
+// caches of the calling thread, one per allocator it has touched
+struct ThreadCacheList {
+    std::vector<std::shared_ptr<ThreadCache>> caches;
+
+    ~ThreadCacheList() {
+        for (auto& cache : caches) {
+            if (!cache->detached.load()) abandon(*cache);
+        }
+    }
+};
+
+thread_local ThreadCacheList thread_caches;
+
+BlockPrefix* prefix_of(void* ptr) {
+    return (BlockPrefix*) ((uint8_t*) ptr - sizeof(BlockPrefix));
+}
+
+size_t class_of(size_t size) {
+    return (size + CLASS_STEP - 1) / CLASS_STEP - 1;
+}
+
+size_t class_size(size_t size_class) {
+    return (size_class + 1) * CLASS_STEP;
+}
+
+// central_lock must be held
+void release_to_central(Allocator& allocator, void* ptr) {
+    FreeList::free(allocator.central, (uint8_t*) ptr - prefix_of(ptr)->offset);
+}
+
+ThreadCache* find_cache(Allocator& allocator) {
+    for (auto& cache : thread_caches.caches) {
+        if (cache->allocator == &allocator && !cache->detached.load()) return cache.get();
+    }
+
+    // first use from this thread, forget caches of destroyed allocators while we are here
+    auto& caches = thread_caches.caches;
+    caches.erase(
+        std::remove_if(caches.begin(), caches.end(), [](const std::shared_ptr<ThreadCache>& cache) { return cache->detached.load(); }),
+        caches.end()
+    );
+
+    auto cache = std::make_shared<ThreadCache>();
+    cache->allocator = &allocator;
+    cache->detached = false;
+    cache->abandoned = false;
+    cache->remote_frees = nullptr;
+    std::fill(cache->bins, cache->bins + CLASS_COUNT, nullptr);
+    std::fill(cache->counts, cache->counts + CLASS_COUNT, 0);
+
+    {
+        std::lock_guard<std::mutex> guard(allocator.caches_lock);
+        allocator.caches.push_back(cache);
+    }
+    caches.push_back(cache);
+
+    return cache.get();
+}
+
+void push_local(ThreadCache& cache, CachedBlock* block, size_t size_class) {
+    block->next = cache.bins[size_class];
+    cache.bins[size_class] = block;
+    cache.counts[size_class]++;
+}
+
+// moves everything other threads freed for us into the bins
+void collect_remote_frees(ThreadCache& cache) {
+    CachedBlock* block = cache.remote_frees.exchange(nullptr, std::memory_order_acquire);
+    while (block != nullptr) {
+        CachedBlock* next = block->next;
+        push_local(cache, block, prefix_of(block)->size_class);
+        block = next;
+    }
+}
+
+// gives count blocks of one class back to the central heap under a single lock,
+// CACHE_BATCH at a time through FreeList::free_batch
+void drain(Allocator& allocator, ThreadCache& cache, size_t size_class, size_t count) {
+    void* payloads[CACHE_BATCH];
+
+    std::lock_guard<std::mutex> guard(allocator.central_lock);
+    while (count > 0 && cache.bins[size_class] != nullptr) {
+        size_t batch = 0;
+        while (batch < CACHE_BATCH && count > 0 && cache.bins[size_class] != nullptr) {
+            CachedBlock* block = cache.bins[size_class];
+            cache.bins[size_class] = block->next;
+            cache.counts[size_class]--;
+            count--;
+            payloads[batch++] = (uint8_t*) block - prefix_of(block)->offset;
+        }
+        FreeList::free_batch(allocator.central, payloads, batch);
+    }
+}
+
+void drain_remote_to_central(Allocator& allocator, ThreadCache& cache) {
+    CachedBlock* block = cache.remote_frees.exchange(nullptr, std::memory_order_acquire);
+    if (block == nullptr) return;
+
+    std::lock_guard<std::mutex> guard(allocator.central_lock);
+    while (block != nullptr) {
+        CachedBlock* next = block->next;
+        release_to_central(allocator, block);
+        block = next;
+    }
+}
+
+void flush(Allocator& allocator, ThreadCache& cache) {
+    collect_remote_frees(cache);
+    for (size_t size_class = 0; size_class < CLASS_COUNT; size_class++) {
+        drain(allocator, cache, size_class, cache.counts[size_class]);
+    }
+}
+
+void abandon(ThreadCache& cache) {
+    // destroy detaches under caches_lock, so holding it keeps the central heap alive until the
+    // flush is done. the check before taking it only happened to see the allocator still there
+    std::lock_guard<std::mutex> guard(cache.allocator->caches_lock);
+    if (cache.detached.load()) return;
+
+    // anyone who pushes after this sees abandoned and cleans up after themselves
+    cache.abandoned.store(true);
+    flush(*cache.allocator, cache);
+}
+
+// pulls one batch of class sized blocks out of the central heap
+void refill(Allocator& allocator, ThreadCache& cache, size_t size_class) {
+    size_t size = sizeof(BlockPrefix) + class_size(size_class);
+
+    void* payloads[CACHE_BATCH];
+    size_t count;
+    {
+        std::lock_guard<std::mutex> guard(allocator.central_lock);
+        count = FreeList::alloc_batch(allocator.central, size, CLASS_ALIGNMENT, payloads, CACHE_BATCH);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        uint8_t* payload = (uint8_t*) payloads[i];
+        CachedBlock* block = (CachedBlock*) (payload + sizeof(BlockPrefix));
+        BlockPrefix* prefix = prefix_of(block);
+        prefix->owner = &cache;
+        prefix->size_class = size_class;
+        prefix->offset = sizeof(BlockPrefix);
+
+        push_local(cache, block, size_class);
+    }
+}
+
+void* alloc_direct(Allocator& allocator, size_t size, size_t alignment) {
+    size_t offset = std::max(sizeof(BlockPrefix), alignment);
+
+    uint8_t* payload;
+    {
+        std::lock_guard<std::mutex> guard(allocator.central_lock);
+        payload = (uint8_t*) FreeList::alloc(allocator.central, offset + size, alignment);
+    }
+    if (payload == nullptr) return nullptr;
+
+    void* ptr = payload + offset;
+    BlockPrefix* prefix = prefix_of(ptr);
+    prefix->owner = nullptr;
+    prefix->size_class = DIRECT_CLASS;
+    prefix->offset = offset;
+    return ptr;
+}
+
+void remote_free(Allocator& allocator, ThreadCache& owner, CachedBlock* block) {
+    CachedBlock* head = owner.remote_frees.load(std::memory_order_relaxed);
+    do {
+        block->next = head;
+    } while (!owner.remote_frees.compare_exchange_weak(head, block, std::memory_order_release, std::memory_order_relaxed));
+
+    // the owner may have exited before it could see our push
+    if (owner.abandoned.load()) drain_remote_to_central(allocator, owner);
+}
+
+// usable bytes behind ptr
+size_t usable_size(Allocator& allocator, void* ptr) {
+    BlockPrefix* prefix = prefix_of(ptr);
+    if (prefix->size_class != DIRECT_CLASS) return class_size(prefix->size_class);
+
+    // direct blocks are as big as the central block they live in
+    std::lock_guard<std::mutex> guard(allocator.central_lock);
+    return FreeList::usableSize(allocator.central, (uint8_t*) ptr - prefix->offset) - prefix->offset;
+}
+
+}
+
+bool init(Allocator& allocator, size_t total_size, FreeList::FitPolicy policy) {
+    allocator.caches.clear();
+    return FreeList::init(allocator.central, total_size, policy);
+}
+
+void* alloc(Allocator& allocator, size_t size, size_t alignment) {
+    size = std::max(size, (size_t)1);
+
+    if (size > MAX_CACHED_SIZE || alignment > CLASS_ALIGNMENT) {
+        return alloc_direct(allocator, size, alignment);
+    }
+
+    size_t size_class = class_of(size);
+    ThreadCache* cache = find_cache(allocator);
+
+    if (cache->bins[size_class] == nullptr) collect_remote_frees(*cache);
+    if (cache->bins[size_class] == nullptr) refill(allocator, *cache, size_class);
+
+    CachedBlock* block = cache->bins[size_class];
+    if (block == nullptr) return nullptr;
+
+    cache->bins[size_class] = block->next;
+    cache->counts[size_class]--;
+    return block;
+}
+
+void free(Allocator& allocator, void* ptr) {
+    if (ptr == nullptr) return;
+
+    BlockPrefix* prefix = prefix_of(ptr);
+    if (prefix->owner == nullptr) {
+        std::lock_guard<std::mutex> guard(allocator.central_lock);
+        release_to_central(allocator, ptr);
+        return;
+    }
+
+    ThreadCache* cache = find_cache(allocator);
+    if (prefix->owner != cache) {
+        remote_free(allocator, *prefix->owner, (CachedBlock*) ptr);
+        return;
+    }
+
+    size_t size_class = prefix->size_class;
+    push_local(*cache, (CachedBlock*) ptr, size_class);
+    if (cache->counts[size_class] > CACHE_LIMIT) {
+        drain(allocator, *cache, size_class, CACHE_BATCH);
+    }
+}
+
+void* realloc(Allocator& allocator, void* ptr, size_t new_size) {
+    if (ptr == nullptr) return alloc(allocator, new_size, CLASS_ALIGNMENT);
+    if (new_size == 0) {
+        free(allocator, ptr);
+        return nullptr;
+    }
+
+    size_t old_size = usable_size(allocator, ptr);
+    if (new_size <= old_size) return ptr;
+
+    void* new_ptr = alloc(allocator, new_size, CLASS_ALIGNMENT);
+    if (new_ptr == nullptr) return nullptr; //failed allocation
+    std::memcpy(new_ptr, ptr, old_size);
+    free(allocator, ptr);
+
+    return new_ptr;
+}
+
+void flushThreadCache(Allocator& allocator) {
+    for (auto& cache : thread_caches.caches) {
+        if (cache->allocator == &allocator && !cache->detached.load()) flush(allocator, *cache);
+    }
+}
+
+void destroy(Allocator& allocator) {
+    {
+        std::lock_guard<std::mutex> guard(allocator.caches_lock);
+        for (auto& cache : allocator.caches) cache->detached.store(true);
+        allocator.caches.clear();
+    }
+    FreeList::destroy(allocator.central);
+}
+}
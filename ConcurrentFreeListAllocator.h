@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <vector>
+
+#include "FreeListAllocator.h"
+
+// thread-safe FreeList: a shared central heap behind small per-thread caches.
+// small requests are served from the calling thread's cache of recently freed blocks,
+// which is refilled from / drained to the central heap in batches under its lock.
+// a block freed by a thread other than the one whose cache it came from is pushed on
+// that cache's lock-free remote-free queue and picked up by the owner on its next miss.
+//
+// destroy must only be called once no other thread uses the allocator anymore
+namespace ConcurrentFreeList {
+
+// cached size classes go up in CLASS_STEP steps up to MAX_CACHED_SIZE
+const size_t CLASS_STEP = 16;
+const size_t CLASS_COUNT = 32;
+const size_t MAX_CACHED_SIZE = CLASS_STEP * CLASS_COUNT;
+const size_t CLASS_ALIGNMENT = 16;
+
+const size_t CACHE_BATCH = 16; // blocks moved between a cache and the central heap at once
+const size_t CACHE_LIMIT = 2 * CACHE_BATCH; // per class, a cache drains CACHE_BATCH blocks above this
+
+struct ThreadCache;
+
+struct Allocator {
+    FreeList::Allocator central;
+    std::mutex central_lock;
+
+    std::mutex caches_lock;
+    std::vector<std::shared_ptr<ThreadCache>> caches; // one per thread that used this allocator
+};
+
+bool init(Allocator& allocator, size_t total_size, FreeList::FitPolicy policy = FreeList::FitPolicy::Segregated);
+
+void* alloc(Allocator& allocator, size_t size, size_t alignment);
+
+void free(Allocator& allocator, void* ptr);
+
+void* realloc(Allocator& allocator, void* ptr, size_t new_size);
+
+// gives everything the calling thread has cached back to the central heap
+void flushThreadCache(Allocator& allocator);
+
+void destroy(Allocator& allocator);
+}
@@ -0,0 +1,149 @@
+#include "ConcurrentLinearAllocator.h"
+#include <algorithm>
+#include <cassert>
+#include <thread>
+
+namespace ConcurrentLinear {
+
+namespace {
+
+const size_t RESETTING = (size_t)1 << (sizeof(size_t) * 8 - 1);
+
+uintptr_t align_up(uintptr_t value, size_t alignment) {
+    return (value + alignment - 1) & ~(uintptr_t)(alignment - 1);
+}
+
+// any alignment: the padding depends on where the offset is, so it is redone on every retry.
+// size is already rounded, the offset has to stay MIN_ALIGNMENT aligned for the fetch_add path
+void* alloc_aligned(Allocator& allocator, size_t size, size_t alignment) {
+    uintptr_t base = (uintptr_t) allocator.memory;
+    size_t current = allocator.offset.load(std::memory_order_relaxed);
+    size_t start;
+
+    do {
+        if (current > allocator.capacity) return nullptr;
+        start = align_up(base + current, alignment) - base;
+        if (start > allocator.capacity || size > allocator.capacity - start) return nullptr;
+    } while (!allocator.offset.compare_exchange_weak(current, start + size, std::memory_order_relaxed));
+
+    return (uint8_t*) allocator.memory + start;
+}
+
+}
+
+bool init(Allocator& allocator, size_t total_size) {
+    allocator.memory = std::malloc(total_size);
+    if (allocator.memory == nullptr) return false;
+    allocator.capacity = total_size;
+    allocator.offset.store(0, std::memory_order_relaxed);
+    allocator.participants.store(0, std::memory_order_relaxed);
+    allocator.epoch.store(0, std::memory_order_relaxed);
+    return true;
+}
+
+void* alloc(Allocator& allocator, size_t size, size_t alignment) {
+    assert((alignment != 0) && ((alignment & (alignment - 1)) == 0) && "alignment must be a power of 2");
+    assert((allocator.participants.load(std::memory_order_relaxed) & ~RESETTING) != 0 && "alloc outside enter/leave");
+
+    // malloc'd memory starts MIN_ALIGNMENT aligned and every step is a multiple of it
+    size_t rounded = (size + MIN_ALIGNMENT - 1) & ~(MIN_ALIGNMENT - 1);
+    if (rounded < size || rounded > allocator.capacity) return nullptr;
+
+    if (alignment > MIN_ALIGNMENT) return alloc_aligned(allocator, rounded, alignment);
+
+    size_t start = allocator.offset.fetch_add(rounded, std::memory_order_relaxed);
+    if (start > allocator.capacity - rounded) return nullptr;
+    return (uint8_t*) allocator.memory + start;
+}
+
+void enter(Allocator& allocator) {
+    size_t current = allocator.participants.load(std::memory_order_relaxed);
+    for (;;) {
+        if (current & RESETTING) {
+            std::this_thread::yield();
+            current = allocator.participants.load(std::memory_order_relaxed);
+            continue;
+        }
+        // acquire pairs with the release in reset, so the new offset and epoch are seen
+        if (allocator.participants.compare_exchange_weak(current, current + 1, std::memory_order_acquire)) return;
+    }
+}
+
+void leave(Allocator& allocator) {
+    size_t before = allocator.participants.fetch_sub(1, std::memory_order_release);
+    assert((before & ~RESETTING) != 0 && "leave without enter");
+    (void)before; // only read by the assert
+}
+
+bool reset(Allocator& allocator) {
+    // nobody can enter while RESETTING is set, and it can only be set while nobody is inside
+    size_t expected = 0;
+    if (!allocator.participants.compare_exchange_strong(expected, RESETTING, std::memory_order_acquire)) return false;
+
+    allocator.offset.store(0, std::memory_order_relaxed);
+    allocator.epoch.fetch_add(1, std::memory_order_relaxed);
+    allocator.participants.store(0, std::memory_order_release);
+    return true;
+}
+
+void attach(LocalArena& local, Allocator& allocator, size_t claim_size) {
+    local.allocator = &allocator;
+    local.cursor = nullptr;
+    local.end = nullptr;
+    local.epoch = 0;
+    local.claim_size = std::max(claim_size, CLAIM_ALIGNMENT);
+}
+
+void* alloc(LocalArena& local, size_t size, size_t alignment) {
+    assert((alignment != 0) && ((alignment & (alignment - 1)) == 0) && "alignment must be a power of 2");
+    Allocator& allocator = *local.allocator;
+
+    // the arena was reset since the claim, the sub-chunk may belong to someone else by now
+    uint64_t epoch = allocator.epoch.load(std::memory_order_relaxed);
+    if (local.epoch != epoch) {
+        local.cursor = nullptr;
+        local.end = nullptr;
+        local.epoch = epoch;
+    }
+
+    if (size > local.claim_size / 4 || alignment > local.claim_size / 4) return alloc(allocator, size, alignment);
+
+    if (local.cursor != nullptr) {
+        uintptr_t start = align_up((uintptr_t) local.cursor, alignment);
+        if (start <= (uintptr_t) local.end && size <= (uintptr_t) local.end - start) {
+            local.cursor = (uint8_t*) (start + size);
+            return (void*) start;
+        }
+    }
+
+    // whatever is left in the old sub-chunk is given up
+    uint8_t* chunk = (uint8_t*) alloc(allocator, local.claim_size, CLAIM_ALIGNMENT);
+    if (chunk == nullptr) return alloc(allocator, size, alignment); // the tail is smaller than a claim
+
+    uintptr_t start = align_up((uintptr_t) chunk, alignment);
+    local.cursor = (uint8_t*) (start + size);
+    local.end = chunk + local.claim_size;
+    return (void*) start;
+}
+
+size_t getUsed(const Allocator& allocator) {
+    return std::min(allocator.offset.load(std::memory_order_relaxed), allocator.capacity);
+}
+
+size_t getAvailable(const Allocator& allocator) {
+    return allocator.capacity - getUsed(allocator);
+}
+
+bool owns(const Allocator& allocator, const void* ptr) {
+    const uint8_t* memory = (const uint8_t*) allocator.memory;
+    return memory <= (const uint8_t*) ptr && (const uint8_t*) ptr < memory + allocator.capacity;
+}
+
+void destroy(Allocator& allocator) {
+    assert((allocator.participants.load(std::memory_order_relaxed) & ~RESETTING) == 0 && "destroy while threads are inside");
+    std::free(allocator.memory);
+    allocator.memory = nullptr;
+    allocator.capacity = 0;
+    allocator.offset.store(0, std::memory_order_relaxed);
+}
+}
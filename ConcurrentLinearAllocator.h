@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <stdint.h>
+
+#include "types.h"
+
+// thread-safe Linear: one fixed arena that many threads bump at once. the shared offset moves
+// with a single fetch_add when the alignment is at most MIN_ALIGNMENT (sizes are rounded up to
+// it, so the offset always stays aligned) and with a CAS loop otherwise, so the padding is worked
+// out against the offset the CAS actually replaces.
+// a LocalArena claims a sub-chunk of CLAIM_SIZE bytes at a time and bumps inside it with no
+// atomics at all, only a claim touches the shared offset.
+//
+// every thread that allocates has to be a participant (enter/leave or Participant). reset only
+// goes through once nobody is inside, it bumps the epoch, which makes every LocalArena drop the
+// sub-chunk it claimed before the reset. destroy must only be called once no other thread uses
+// the allocator anymore
+namespace ConcurrentLinear {
+
+const size_t CLAIM_SIZE = 64 * 1024;
+const size_t CLAIM_ALIGNMENT = 64; // a cache line, so sub-chunks of two threads never share one
+
+struct Allocator {
+    void* memory;
+    size_t capacity;
+    alignas(64) std::atomic<size_t> offset; // can run past capacity after a failed fetch_add, see alloc
+    alignas(64) std::atomic<size_t> participants; // threads inside, RESETTING bit while reset runs
+    std::atomic<uint64_t> epoch; // bumped by every reset
+};
+
+// one thread's sub-chunk, must not be shared between threads
+struct LocalArena {
+    Allocator* allocator;
+    uint8_t* cursor;
+    uint8_t* end;
+    uint64_t epoch; // of the arena when the sub-chunk was claimed
+    size_t claim_size;
+};
+
+bool init(Allocator& allocator, size_t total_size);
+
+// bumps the shared offset. a request that does not fit fails, and with alignment up to
+// MIN_ALIGNMENT the tail it overshot is given up until the next reset
+void* alloc(Allocator& allocator, size_t size, size_t alignment);
+
+void enter(Allocator& allocator);
+
+void leave(Allocator& allocator);
+
+// rewinds the arena, returns false (and does nothing) while any thread is still inside
+bool reset(Allocator& allocator);
+
+void attach(LocalArena& local, Allocator& allocator, size_t claim_size = CLAIM_SIZE);
+
+// bumps the local sub-chunk, claims a new one when it is full. requests bigger than a quarter
+// of the claim size go straight to the shared offset, they would waste most of a sub-chunk
+void* alloc(LocalArena& local, size_t size, size_t alignment);
+
+// bytes handed out, claimed sub-chunks count in full
+size_t getUsed(const Allocator& allocator);
+
+size_t getAvailable(const Allocator& allocator);
+
+bool owns(const Allocator& allocator, const void* ptr);
+
+void destroy(Allocator& allocator);
+
+// enter on construction, leave on destruction
+class Participant {
+    public:
+        explicit Participant(Allocator& allocator) : allocator(allocator) { enter(allocator); }
+        ~Participant() { leave(allocator); }
+
+        Participant(const Participant&) = delete;
+        Participant& operator=(const Participant&) = delete;
+
+    private:
+        Allocator& allocator;
+};
+}
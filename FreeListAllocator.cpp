@@ -4,184 +4,1155 @@
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <sys/types.h>
+#include <atomic>
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
+
+// block layout (every block starts 8 byte aligned and its size is a multiple of 8):
+//
+//   used: [AllocationHeader][padding ...][padding copy][payload ...]
+//   free: [Node][...][footer]
+//
+// the first word of every block is its physical size with the flag bits below, so
+// the physically next block is always at block + size. free blocks repeat their size
+// in their last word (footer), which lets the block after them step back to them when
+// it has BLOCK_PREV_FREE set. the arena ends with a zero sized used sentinel.
+// when padding is not zero, it is also written to the word right before the payload,
+// so free can always find the header at payload - padding - header_size.
+//
+// a grown region is laid out the same way, with its Region header after the sentinel.
+//
+// with compact headers the used block header is just the first word, its high 32 bits
+// hold the padding (and so does the high half of the padding copy). free blocks look the same
+// in both modes, their sizes fit in 32 bits anyway since the arena is under 4 GiB
 
 namespace FreeList {
-bool init(Allocator& allocator, size_t total_size) {
-        void* raw_memory = std::malloc(total_size);
-        if (raw_memory == nullptr) return false;
 
-        allocator.memory = raw_memory;
-        allocator.capacity = total_size;
+namespace {
 
-        // ensure the initial memory is aligned to allow Node storage
-        uintptr_t current_addr = (uintptr_t) raw_memory;
+const size_t BLOCK_USED = 1 << 0;
+const size_t BLOCK_PREV_FREE = 1 << 1;
+// free blocks only: every byte past FREE_HEADER_SIZE up to the footer is known to be zero
+const size_t BLOCK_ZERO = 1 << 2;
+const size_t BLOCK_FLAGS = BLOCK_USED | BLOCK_PREV_FREE | BLOCK_ZERO;
 
-        // round up the to next alignment of Node
-        uintptr_t aligned_addr = (current_addr + alignof(Node) - 1) & ~(alignof(Node) - 1);
+// bigger sizes and alignments are refused up front, so adding the header and padding and
+// rounding to alignof(Node) can never wrap around
+const size_t MAX_REQUEST_SIZE = SIZE_MAX / 2;
 
-        size_t adjustment = aligned_addr - current_addr;
+size_t& tag(void* block) {
+    return *(size_t*) block;
+}
 
-        if (allocator.capacity < adjustment + sizeof(Node)) {
-            allocator.free_list = nullptr;
-            allocator.capacity = 0;
-            return false; // memory too small to hold even one node
+size_t block_size(const void* block) {
+    return *(const size_t*) block & ~BLOCK_FLAGS;
+}
+
+bool is_used(void* block) {
+    return tag(block) & BLOCK_USED;
+}
+
+bool is_prev_free(void* block) {
+    return tag(block) & BLOCK_PREV_FREE;
+}
+
+uint8_t* next_block(void* block) {
+    return (uint8_t*) block + block_size(block);
+}
+
+// only valid when block has BLOCK_PREV_FREE set
+Node* prev_block(void* block) {
+    size_t prev_size = *((size_t*) block - 1);
+    return (Node*) ((uint8_t*) block - prev_size);
+}
+
+void write_footer(Node* node) {
+    *(size_t*) (next_block(node) - sizeof(size_t)) = block_size(node);
+}
+
+const size_t COMPACT_SIZE_MASK = 0xFFFFFFFF;
+const size_t COMPACT_PADDING_SHIFT = 32;
+const size_t COMPACT_ARENA_LIMIT = (size_t)1 << 32;
+
+// size of a used block, without the padding bits of a compact header
+size_t used_block_size(const Allocator& allocator, void* block) {
+    size_t size = block_size(block);
+    return allocator.compact_headers ? size & COMPACT_SIZE_MASK : size;
+}
+
+// changes the size of a used block, keeping its flags and padding
+void set_used_block_size(const Allocator& allocator, void* block, size_t size) {
+    tag(block) = tag(block) - used_block_size(allocator, block) + size;
+}
+
+size_t padding_of(const Allocator& allocator, void* ptr) {
+    size_t word = *((size_t*) ptr - 1);
+    return allocator.compact_headers ? word >> COMPACT_PADDING_SHIFT : word;
+}
+
+AllocationHeader* header_of(const Allocator& allocator, void* ptr) {
+    return (AllocationHeader*) ((uint8_t*) ptr - padding_of(allocator, ptr) - allocator.header_size);
+}
+
+size_t bin_index(size_t physical) {
+    if (physical < SMALL_BIN_LIMIT) return physical / MIN_ALIGNMENT;
+
+    size_t log2 = 63 - __builtin_clzll(physical);
+    size_t index = SMALL_BIN_COUNT + log2 - 8; // 8 == log2(SMALL_BIN_LIMIT)
+    return std::min(index, BIN_COUNT - 1);
+}
+
+// the tree policies keep only blocks of at least SMALL_BIN_LIMIT in the tree, smaller ones
+// go to the exact size bins (a tree node would not fit in them anyway)
+bool uses_tree(const Allocator& allocator) {
+    return allocator.policy == FitPolicy::BestFit || allocator.policy == FitPolicy::AddressOrderedBestFit;
+}
+
+bool in_tree(const Allocator& allocator, size_t size) {
+    return uses_tree(allocator) && size >= SMALL_BIN_LIMIT;
+}
+
+}
+
+// a free block in the tree: [TreeNode][...][footer]. next and prev of the Node are unused
+struct TreeNode : Node {
+    TreeNode* left;
+    TreeNode* right;
+    TreeNode* parent;
+};
+
+namespace {
+
+static_assert(sizeof(TreeNode) + sizeof(size_t) <= SMALL_BIN_LIMIT, "tree nodes must fit in every tree block");
+
+// bytes at the start of a free block that hold its links, whichever structure it is in
+const size_t FREE_HEADER_SIZE = sizeof(TreeNode);
+
+// clears and moving copies from here up skip the cache. below it memset / memcpy win, the
+// block is usually still cached and streaming stores would push it all the way out to memory
+const size_t STREAM_THRESHOLD = 8 * 1024 * 1024;
+// realloc moves page aligned payloads from here up with mremap. the move pays for dropping the
+// destination's pages and splits the arena's mapping, at 1 MiB it was no faster than the copy
+const size_t REMAP_THRESHOLD = 2 * 1024 * 1024;
+
+// treap priority, a hash of the address keeps the tree balanced in expectation without storing it
+uint64_t priority(const TreeNode* node) {
+    uint64_t hash = (uintptr_t) node * 0x9E3779B97F4A7C15ull;
+    return hash ^ (hash >> 29);
+}
+
+// in-order key: size, then address for AddressOrderedBestFit. BestFit leaves equal sizes
+// unordered (a new one goes right of the ones already there)
+bool tree_less(const Allocator& allocator, const TreeNode* a, const TreeNode* b) {
+    if (block_size(a) != block_size(b)) return block_size(a) < block_size(b);
+    return allocator.policy == FitPolicy::AddressOrderedBestFit && a < b;
+}
+
+// the pointer that points at node
+TreeNode*& tree_link(Allocator& allocator, TreeNode* node) {
+    if (node->parent == nullptr) return allocator.tree_root;
+    return node->parent->left == node ? node->parent->left : node->parent->right;
+}
+
+// node takes its parent's place, in-order stays the same
+void rotate_up(Allocator& allocator, TreeNode* node) {
+    TreeNode* parent = node->parent;
+    TreeNode*& link = tree_link(allocator, parent);
+
+    if (parent->left == node) {
+        parent->left = node->right;
+        if (node->right != nullptr) node->right->parent = parent;
+        node->right = parent;
+    } else {
+        parent->right = node->left;
+        if (node->left != nullptr) node->left->parent = parent;
+        node->left = parent;
+    }
+    node->parent = parent->parent;
+    parent->parent = node;
+    link = node;
+}
+
+void tree_insert(Allocator& allocator, TreeNode* node) {
+    node->left = nullptr;
+    node->right = nullptr;
+
+    TreeNode* parent = nullptr;
+    TreeNode** link = &allocator.tree_root;
+    while (*link != nullptr) {
+        parent = *link;
+        link = tree_less(allocator, node, parent) ? &parent->left : &parent->right;
+    }
+    node->parent = parent;
+    *link = node;
+
+    while (node->parent != nullptr && priority(node) > priority(node->parent)) rotate_up(allocator, node);
+}
+
+void tree_remove(Allocator& allocator, TreeNode* node) {
+    // rotate it down to a leaf, then cut it off
+    while (node->left != nullptr || node->right != nullptr) {
+        bool take_left = node->right == nullptr || (node->left != nullptr && priority(node->left) > priority(node->right));
+        rotate_up(allocator, take_left ? node->left : node->right);
+    }
+    tree_link(allocator, node) = nullptr;
+}
+
+// first block in order that holds at least size bytes
+TreeNode* tree_lower_bound(const Allocator& allocator, size_t size) {
+    TreeNode* best = nullptr;
+    for (TreeNode* curr = allocator.tree_root; curr != nullptr;) {
+        if (block_size(curr) >= size) {
+            best = curr;
+            curr = curr->left;
+        } else {
+            curr = curr->right;
         }
+    }
+    return best;
+}
 
-        allocator.free_list = (Node*) aligned_addr;
-        allocator.free_list->block_size = allocator.capacity - adjustment - sizeof(Node);
-        allocator.free_list->next = nullptr;
+TreeNode* tree_successor(TreeNode* node) {
+    if (node->right != nullptr) {
+        node = node->right;
+        while (node->left != nullptr) node = node->left;
+        return node;
+    }
+    while (node->parent != nullptr && node->parent->right == node) node = node->parent;
+    return node->parent;
+}
 
-        return true;
+TreeNode* tree_first(const Allocator& allocator) {
+    TreeNode* node = allocator.tree_root;
+    while (node != nullptr && node->left != nullptr) node = node->left;
+    return node;
+}
 
+// head of the list node belongs in
+Node*& list_head(Allocator& allocator, Node* node) {
+    if (allocator.policy != FitPolicy::FirstFit) {
+        return allocator.bins[bin_index(block_size(node))];
+    }
+    return allocator.free_list;
 }
 
-void* alloc(Allocator& allocator, size_t size, size_t alignment) {
+void insert_free_block(Allocator& allocator, Node* node) {
+    if (in_tree(allocator, block_size(node))) {
+        tree_insert(allocator, (TreeNode*) node);
+        return;
+    }
 
-    size = std::max(size, MIN_ALLOC_SIZE); // enforce size
-    alignment = std::max(alignment, MIN_ALIGNMENT); // enforce alignment
+    Node*& head = list_head(allocator, node);
+    node->prev = nullptr;
+    node->next = head;
+    if (head != nullptr) head->prev = node;
+    head = node;
+
+    if (allocator.policy != FitPolicy::FirstFit) {
+        allocator.bin_bitmap |= (uint64_t)1 << bin_index(block_size(node));
+    }
+}
+
+void remove_free_block(Allocator& allocator, Node* node) {
+    if (in_tree(allocator, block_size(node))) {
+        tree_remove(allocator, (TreeNode*) node);
+        return;
+    }
+
+    Node*& head = list_head(allocator, node);
+    if (node->prev != nullptr) {
+        node->prev->next = node->next;
+    } else {
+        head = node->next;
+    }
+    if (node->next != nullptr) node->next->prev = node->prev;
 
-    Node* prev = nullptr;
-    Node* curr = allocator.free_list;
+    if (allocator.policy != FitPolicy::FirstFit && head == nullptr) {
+        allocator.bin_bitmap &= ~((uint64_t)1 << bin_index(block_size(node)));
+    }
+}
 
-    while (curr != nullptr) { // find first block that is large enough
+// calls fn on every free block, whichever structure holds it
+template <typename Fn>
+void for_each_free_block(const Allocator& allocator, Fn fn) {
+    if (allocator.policy == FitPolicy::FirstFit) {
+        for (Node* curr = allocator.free_list; curr != nullptr; curr = curr->next) fn(curr);
+        return;
+    }
+    for (size_t i = 0; i < BIN_COUNT; i++) {
+        for (Node* curr = allocator.bins[i]; curr != nullptr; curr = curr->next) fn(curr);
+    }
+    for (TreeNode* curr = tree_first(allocator); curr != nullptr; curr = tree_successor(curr)) fn(curr);
+}
 
-        // calculate alignment padding (front)
-        // we want the payload (after header) to be aligned
+// turns the span at node (size bytes, its tag already holds BLOCK_PREV_FREE if that applies)
+// into a free block, merging it with free physical neighbours. returns the merged block
+Node* release_block(Allocator& allocator, Node* node, size_t size) {
+    uint8_t* next = (uint8_t*) node + size;
 
-        uintptr_t current_addr = (uintptr_t) curr;
-        uintptr_t raw_payload_addr = current_addr + sizeof(AllocationHeader); // where payload would naturally start
+    // join next
+    if (!is_used(next)) {
+        remove_free_block(allocator, (Node*) next);
+        size += block_size(next);
+    }
+
+    // join prev
+    if (is_prev_free(node)) {
+        Node* prev = prev_block(node);
+        remove_free_block(allocator, prev);
+        size += block_size(prev);
+        node = prev;
+    }
 
-        size_t alignment_padding = 0;
-        size_t misalign = raw_payload_addr & (alignment - 1);
-        // this is equivalent to % modulo (only when alignment is a power of 2)
-        // but better because bitwise AND is faster
-        if (misalign != 0) {
-            alignment_padding = alignment - misalign;
+    // whatever is before us is used now (or we would have merged with it)
+    node->block_size = size;
+    write_footer(node);
+    tag(next_block(node)) |= BLOCK_PREV_FREE;
+
+    insert_free_block(allocator, node);
+    return node;
+}
+
+// sentinels are the only zero sized blocks
+bool is_sentinel(void* block) {
+    return block_size(block) == 0;
+}
+
+uint8_t* arena_sentinel(const Allocator& allocator) {
+    return (uint8_t*) ((((uintptr_t) allocator.memory + allocator.capacity) & ~(alignof(Node) - 1)) - sizeof(size_t));
+}
+
+void* map_region_memory(const Allocator& allocator, size_t& size) {
+    if (allocator.mmap_regions) return Pages::reserve(size, Pages::HugePages::Off);
+    return std::malloc(size);
+}
+
+void unmap_region_memory(const Allocator& allocator, void* memory, size_t size) {
+    if (allocator.mmap_regions) Pages::release(memory, size);
+    else std::free(memory);
+}
+
+// index of the first span in the region table that starts above p
+size_t region_table_upper(const Allocator& allocator, const void* p) {
+    size_t low = 0;
+    size_t high = allocator.region_table_count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (allocator.region_table[mid].start <= (const uint8_t*) p) low = mid + 1;
+        else high = mid;
+    }
+    return low;
+}
+
+// adds the mapping at memory to the region table, false when the table cannot grow.
+// the table lives in its own pages, so growth never needs the arena or malloc
+bool region_table_insert(Allocator& allocator, const uint8_t* memory, size_t size) {
+    if (allocator.region_table_count == allocator.region_table_capacity) {
+        size_t table_size = std::max(allocator.region_table_capacity * 2 * sizeof(RegionSpan), Pages::page_size());
+        RegionSpan* table = (RegionSpan*) Pages::reserve(table_size);
+        if (table == nullptr) return false;
+        if (allocator.region_table != nullptr) {
+            std::memcpy(table, allocator.region_table, allocator.region_table_count * sizeof(RegionSpan));
+            Pages::release(allocator.region_table, allocator.region_table_capacity * sizeof(RegionSpan));
         }
+        allocator.region_table = table;
+        allocator.region_table_capacity = table_size / sizeof(RegionSpan);
+    }
+
+    size_t i = region_table_upper(allocator, memory);
+    RegionSpan* table = allocator.region_table;
+    std::memmove(table + i + 1, table + i, (allocator.region_table_count - i) * sizeof(RegionSpan));
+    table[i] = RegionSpan{memory, memory + size};
+    allocator.region_table_count++;
+    return true;
+}
+
+void region_table_remove(Allocator& allocator, const uint8_t* memory) {
+    size_t i = region_table_upper(allocator, memory) - 1;
+    assert(allocator.region_table[i].start == memory && "region is not in the table");
+    RegionSpan* table = allocator.region_table;
+    std::memmove(table + i, table + i + 1, (allocator.region_table_count - i - 1) * sizeof(RegionSpan));
+    allocator.region_table_count--;
+}
+
+// maps a region that can hold size bytes at alignment and hands its space to the free structures
+bool grow(Allocator& allocator, size_t size, size_t alignment) {
+    size_t overhead = allocator.header_size + alignment + MIN_BLOCK_SIZE + sizeof(size_t) + sizeof(Region);
+    if (size > SIZE_MAX / 2 - overhead) return false;
+
+    size_t region_size = std::max(allocator.next_region_size, size + overhead);
+    if (allocator.compact_headers && region_size >= COMPACT_ARENA_LIMIT) return false;
+
+    uint8_t* memory = (uint8_t*) map_region_memory(allocator, region_size);
+    if (memory == nullptr) return false;
+    if (!region_table_insert(allocator, memory, region_size)) {
+        unmap_region_memory(allocator, memory, region_size);
+        return false;
+    }
+
+    // malloc and mmap both hand out memory aligned for a Node
+    Region* region = (Region*) (((uintptr_t) memory + region_size - sizeof(Region)) & ~(alignof(Region) - 1));
+    region->memory = memory;
+    region->size = region_size;
+    region->prev = nullptr;
+    region->next = allocator.regions;
+    if (allocator.regions != nullptr) allocator.regions->prev = region;
+    allocator.regions = region;
+
+    uint8_t* sentinel = (uint8_t*) region - sizeof(size_t);
+    tag(sentinel) = BLOCK_USED;
+
+    Node* first = (Node*) memory;
+    first->block_size = sentinel - memory;
+    release_block(allocator, first, first->block_size);
+    if (allocator.mmap_regions) tag(first) |= BLOCK_ZERO; // fresh mappings are zero, malloc's memory is not
+
+    allocator.next_region_size = std::min(allocator.next_region_size * 2, allocator.max_region_size);
+    return true;
+}
+
+// node is a free block that just came out of release_block, unmaps its region when it is
+// the only block left there. only grown regions end in a sentinel followed by a Region
+void release_if_empty(Allocator& allocator, Node* node) {
+    uint8_t* next = next_block(node);
+    if (!is_sentinel(next) || next == arena_sentinel(allocator)) return;
+
+    Region* region = (Region*) (next + sizeof(size_t));
+    if ((void*) node != region->memory) return;
+
+    remove_free_block(allocator, node);
+    if (region->prev != nullptr) region->prev->next = region->next;
+    else allocator.regions = region->next;
+    if (region->next != nullptr) region->next->prev = region->prev;
+
+    region_table_remove(allocator, (const uint8_t*) region->memory);
+    unmap_region_memory(allocator, region->memory, region->size);
+}
 
-        // calcuate required size and alignment slack (back)
-        // total used memory must be a multiple of alignof(Node)
-        // so that the *next* block starts on a valid address
-        size_t required_size = sizeof(AllocationHeader) + alignment_padding + size;
-        size_t alignment_slack = 0;
-        size_t remainder = required_size % alignof(Node);
-        if (remainder != 0) {
-            alignment_slack = alignof(Node) - remainder;
-            required_size += alignment_slack;
+// frees the used block at header
+void release_used_block(Allocator& allocator, AllocationHeader* header) {
+    assert(is_used(header) && "block already freed");
+
+    ALLOC_STAT(allocator.counters.free_count++);
+    ALLOC_STAT(allocator.counters.bytes_in_use -= used_block_size(allocator, header));
+
+    Node* node = release_block(allocator, (Node*) header, used_block_size(allocator, header));
+    if (allocator.release_empty_regions) release_if_empty(allocator, node);
+}
+
+#ifdef ALLOC_STATS
+void add_in_use(Allocator& allocator, size_t bytes) {
+    allocator.counters.bytes_in_use += bytes;
+    allocator.counters.peak_bytes_in_use = std::max(allocator.counters.peak_bytes_in_use, allocator.counters.bytes_in_use);
+}
+#endif
+
+// physical size of the block alloc(size) with no front padding ends up with (before any slack)
+size_t cached_block_size(const Allocator& allocator, size_t size) {
+    size_t physical = (allocator.header_size + std::max(size, MIN_ALLOC_SIZE) + MIN_ALIGNMENT - 1) & ~(MIN_ALIGNMENT - 1);
+    return std::max(physical, MIN_BLOCK_SIZE);
+}
+
+// pops a cached block of exactly the physical size alloc(size) needs, nullptr when there is none
+void* pop_cached(Allocator& allocator, size_t size) {
+    if (size >= SMALL_BIN_LIMIT) return nullptr;
+    size_t physical = cached_block_size(allocator, size);
+    if (physical >= SMALL_BIN_LIMIT) return nullptr;
+
+    void*& top = allocator.cache_stacks[physical / MIN_ALIGNMENT];
+    void* ptr = top;
+    if (ptr == nullptr) return nullptr;
+    top = *(void**) ptr;
+    allocator.cached_bytes -= physical;
+
+    ALLOC_STAT(add_in_use(allocator, physical));
+    ALLOC_STAT(allocator.counters.alloc_count++);
+    return ptr;
+}
+
+// hands every cached block to release_block, their stats were settled when they were cached
+void flush_cached(Allocator& allocator) {
+    for (void*& top : allocator.cache_stacks) {
+        while (top != nullptr) {
+            void* ptr = top;
+            top = *(void**) ptr;
+            Node* node = release_block(allocator, (Node*) header_of(allocator, ptr), used_block_size(allocator, header_of(allocator, ptr)));
+            if (allocator.release_empty_regions) release_if_empty(allocator, node);
         }
+    }
+    allocator.cached_bytes = 0;
+}
 
-        size_t total_available = curr->block_size + sizeof(Node);
+// caches the used block at header (payload ptr) instead of freeing it. false when it does not
+// qualify: too big, or it has front padding and so cannot serve a plain alloc
+bool push_cached(Allocator& allocator, AllocationHeader* header, void* ptr) {
+    size_t physical = used_block_size(allocator, header);
+    if (physical >= SMALL_BIN_LIMIT || (uint8_t*) ptr != (uint8_t*) header + allocator.header_size) return false;
 
-        if (total_available >= required_size) {
+    assert(is_used(header) && "block already freed");
+    void*& top = allocator.cache_stacks[physical / MIN_ALIGNMENT];
+    *(void**) ptr = top;
+    top = ptr;
+    allocator.cached_bytes += physical;
 
-            Node* next_free_node = curr->next;
-            size_t leftover = total_available - required_size;
+    ALLOC_STAT(allocator.counters.free_count++);
+    ALLOC_STAT(allocator.counters.bytes_in_use -= physical);
 
-            if (leftover >= MIN_SPLIT_SIZE) {
-                // split
-                uintptr_t new_node_addr = current_addr + required_size;
-                Node* new_node = (Node*) new_node_addr;
-                new_node->block_size = leftover - sizeof(Node);
-                new_node->next = next_free_node;
-                next_free_node = new_node;
+    if (allocator.cached_bytes > allocator.front_cache_limit) flush_cached(allocator);
+    return true;
+}
 
-            } else {
-                // no split, consume the extra leftover as slack
-                alignment_slack += leftover;
-                required_size += leftover;
-            }
+struct Fit {
+    size_t alignment_padding;
+    size_t required_size;
+};
+
+// works out how much of the free block at node an allocation would take
+Fit compute_fit(const Allocator& allocator, const Node* node, size_t size, size_t alignment) {
+    Fit fit;
+
+    // calculate alignment padding (front)
+    // we want the payload (after header) to be aligned
+    uintptr_t raw_payload_addr = (uintptr_t) node + allocator.header_size; // where payload would naturally start
+
+    fit.alignment_padding = 0;
+    size_t misalign = raw_payload_addr & (alignment - 1);
+    // this is equivalent to % modulo (only when alignment is a power of 2)
+    // but better because bitwise AND is faster
+    if (misalign != 0) {
+        fit.alignment_padding = alignment - misalign;
+    }
 
-            // setup allocation header
-            // header sits just before the aligned payload
-            uintptr_t aligned_payload_addr = raw_payload_addr + alignment_padding;
-            uintptr_t header_addr = aligned_payload_addr - sizeof(AllocationHeader);
+    // calcuate required size and alignment slack (back)
+    // total used memory must be a multiple of alignof(Node)
+    // so that the *next* block starts on a valid address
+    fit.required_size = allocator.header_size + fit.alignment_padding + size;
+    size_t remainder = fit.required_size % alignof(Node);
+    if (remainder != 0) {
+        fit.required_size += alignof(Node) - remainder;
+    }
+    // it has to be able to turn back into a free block
+    fit.required_size = std::max(fit.required_size, MIN_BLOCK_SIZE);
 
-            AllocationHeader* header = (AllocationHeader*) header_addr;
-            // std::cout << "alloc_header is " << (uintptr_t) header << std::endl;
+    return fit;
+}
 
-            // "padding" stores only the front offset (to rewind ptr in free)
-            // "block size" stores requested size + back slack (to bridge gap in free)
-            header->padding = alignment_padding;
-            header->block_size = size + alignment_slack;
+// writes the used header for fit at block (fit.required_size is the final block size)
+// and returns the payload. keeps the block's BLOCK_PREV_FREE bit
+void* place(const Allocator& allocator, void* block, Fit fit) {
+    uintptr_t current_addr = (uintptr_t) block;
+
+    // setup allocation header, it sits at the start of the block
+    AllocationHeader* header = (AllocationHeader*) block;
+    size_t padding_word = fit.alignment_padding;
+    if (allocator.compact_headers) {
+        padding_word <<= COMPACT_PADDING_SHIFT;
+        header->block_size = fit.required_size | BLOCK_USED | (header->block_size & BLOCK_PREV_FREE) | padding_word;
+    } else {
+        header->block_size = fit.required_size | BLOCK_USED | (header->block_size & BLOCK_PREV_FREE);
+        header->padding = fit.alignment_padding;
+    }
 
-            // update free list
-            if (prev == nullptr) {
-                allocator.free_list = next_free_node;
-            } else {
-                prev->next = next_free_node;
-            }
+    uintptr_t aligned_payload_addr = current_addr + allocator.header_size + fit.alignment_padding;
+    if (fit.alignment_padding != 0) {
+        *((size_t*) aligned_payload_addr - 1) = padding_word;
+    }
+
+    return (void*) aligned_payload_addr;
+}
 
-            return (void*)aligned_payload_addr;
+// turns the free block at node into an allocation, splitting off the tail when it is big enough.
+// node must already be out of the free structures. zeroed (when given) tells whether the block
+// was known to be zero past FREE_HEADER_SIZE, a split off tail stays that way
+void* carve(Allocator& allocator, Node* node, Fit fit, bool* zeroed = nullptr) {
+    uintptr_t current_addr = (uintptr_t) node;
+    size_t available = block_size(node);
+    size_t leftover = available - fit.required_size;
+    size_t zero_flag = tag(node) & BLOCK_ZERO;
+    if (zeroed != nullptr) *zeroed = zero_flag != 0;
+
+    if (leftover >= MIN_SPLIT_SIZE) {
+        // split, the block after the tail already knows its prev is free
+        Node* remainder = (Node*) (current_addr + fit.required_size);
+        remainder->block_size = leftover | zero_flag;
+        write_footer(remainder);
+        insert_free_block(allocator, remainder);
+    } else {
+        // no split, consume the extra leftover as slack
+        fit.required_size = available;
+        tag(next_block(node)) &= ~BLOCK_PREV_FREE;
+    }
 
+    ALLOC_STAT(add_in_use(allocator, fit.required_size));
+    return place(allocator, node, fit);
+}
+
+// cuts as many size byte blocks out of the free block at node as it holds (up to n), front to back.
+// node must already be out of the free structures, whatever is left goes back in. returns the count
+size_t carve_run(Allocator& allocator, Node* node, size_t size, size_t alignment, void** out, size_t n) {
+    uint8_t* cursor = (uint8_t*) node;
+    size_t remaining = block_size(node);
+    size_t zero_flag = tag(node) & BLOCK_ZERO;
+    size_t count = 0;
+
+    while (count < n) {
+        Fit fit = compute_fit(allocator, (Node*) cursor, size, alignment);
+        if (fit.required_size > remaining) break;
+
+        // a tail too small to stay free is slack of the last block
+        if (remaining - fit.required_size < MIN_SPLIT_SIZE) fit.required_size = remaining;
+
+        if (cursor != (uint8_t*) node) tag(cursor) = 0; // only the first block can have a free prev
+        out[count++] = place(allocator, cursor, fit);
+        ALLOC_STAT(add_in_use(allocator, fit.required_size));
+
+        cursor += fit.required_size;
+        remaining -= fit.required_size;
+        if (remaining == 0) {
+            tag(cursor) &= ~BLOCK_PREV_FREE;
+            return count;
         }
+    }
 
-        prev = curr;
-        curr = curr->next;
+    // the rest stays free, the block after it already knows its prev is free
+    Node* rest = (Node*) cursor;
+    rest->block_size = remaining | zero_flag;
+    write_footer(rest);
+    insert_free_block(allocator, rest);
+    return count;
+}
+
+void* alloc_first_fit(Allocator& allocator, size_t size, size_t alignment, bool* zeroed) {
+    for (Node* curr = allocator.free_list; curr != nullptr; curr = curr->next) { // find first block that is large enough
+        ALLOC_STAT(allocator.counters.nodes_scanned++);
+        Fit fit = compute_fit(allocator, curr, size, alignment);
+
+        if (block_size(curr) >= fit.required_size) {
+            remove_free_block(allocator, curr);
+            return carve(allocator, curr, fit, zeroed);
+        }
     }
 
     return nullptr;
+}
 
+// first block in bins[index] that holds the allocation, blocks in one big bin are only
+// roughly the same size so each one is checked
+void* alloc_from_bin(Allocator& allocator, size_t index, size_t size, size_t alignment, bool* zeroed) {
+    for (Node* curr = allocator.bins[index]; curr != nullptr; curr = curr->next) {
+        ALLOC_STAT(allocator.counters.nodes_scanned++);
+        Fit fit = compute_fit(allocator, curr, size, alignment);
+
+        if (block_size(curr) >= fit.required_size) {
+            remove_free_block(allocator, curr);
+            return carve(allocator, curr, fit, zeroed);
+        }
+    }
+    return nullptr;
+}
+
+void* alloc_segregated(Allocator& allocator, size_t size, size_t alignment, bool* zeroed) {
+    // smallest block that could possibly fit (no front padding), everything below it is skipped
+    size_t min_required = allocator.header_size + size;
+    uint64_t candidates = allocator.bin_bitmap & (~(uint64_t)0 << bin_index(min_required));
+
+    // front padding depends on where a block starts, so over-aligned requests check every block
+    if (alignment > MIN_ALIGNMENT) {
+        for (; candidates != 0; candidates &= candidates - 1) {
+            void* ptr = alloc_from_bin(allocator, __builtin_ctzll(candidates), size, alignment, zeroed);
+            if (ptr != nullptr) return ptr;
+        }
+        return nullptr;
+    }
+
+    // without padding the block size is known up front. a small bin holds exactly that size
+    // and every block in a bin above it is bigger, so one look at a head decides. a big bin
+    // spans a power of two, only its head is tried before moving up
+    size_t required = cached_block_size(allocator, size);
+    size_t index = bin_index(required);
+    candidates = allocator.bin_bitmap & (~(uint64_t)0 << index);
+    if (candidates == 0) return nullptr;
+
+    Node* node = allocator.bins[index];
+    if (node == nullptr || block_size(node) < required) {
+        uint64_t above = candidates & ~((uint64_t)1 << index);
+        // only required's own bin is left, some block behind its head may still be big enough
+        if (above == 0) return alloc_from_bin(allocator, index, size, alignment, zeroed);
+        node = allocator.bins[__builtin_ctzll(above)];
+    }
+
+    ALLOC_STAT(allocator.counters.nodes_scanned++);
+    remove_free_block(allocator, node);
+    return carve(allocator, node, compute_fit(allocator, node, size, alignment), zeroed);
+}
+
+// smallest tree block that can hold the allocation. usually the lower bound itself, only a
+// stricter alignment can make it walk on to bigger blocks
+TreeNode* tree_fit(Allocator& allocator, size_t size, size_t alignment) {
+    for (TreeNode* curr = tree_lower_bound(allocator, allocator.header_size + size); curr != nullptr; curr = tree_successor(curr)) {
+        ALLOC_STAT(allocator.counters.nodes_scanned++);
+        if (block_size(curr) >= compute_fit(allocator, curr, size, alignment).required_size) return curr;
+    }
+    return nullptr;
+}
+
+void* alloc_best_fit(Allocator& allocator, size_t size, size_t alignment, bool* zeroed) {
+    // the small bins hold one size each, so the first one that fits is the best fit.
+    // only small bins are ever marked in the bitmap under the tree policies
+    void* ptr = alloc_segregated(allocator, size, alignment, zeroed);
+    if (ptr != nullptr) return ptr;
+
+    TreeNode* node = tree_fit(allocator, size, alignment);
+    if (node == nullptr) return nullptr;
+
+    Fit fit = compute_fit(allocator, node, size, alignment);
+    tree_remove(allocator, node);
+    return carve(allocator, node, fit, zeroed);
+}
+
+// alloc, zeroed (when given) tells whether the block came from memory known to be zero
+void* allocate(Allocator& allocator, size_t size, size_t alignment, bool* zeroed) {
+    if (size > MAX_REQUEST_SIZE || alignment > MAX_REQUEST_SIZE) {
+        ALLOC_STAT(allocator.counters.failed_allocs++);
+        return nullptr;
+    }
+
+    if (allocator.front_cache && alignment <= MIN_ALIGNMENT) {
+        void* ptr = pop_cached(allocator, size);
+        if (ptr != nullptr) return ptr;
+    }
+
+    size = std::max(size, MIN_ALLOC_SIZE); // enforce size
+    alignment = std::max(alignment, MIN_ALIGNMENT); // enforce alignment
+
+    auto try_alloc = [&]() {
+        if (allocator.policy == FitPolicy::Segregated) return alloc_segregated(allocator, size, alignment, zeroed);
+        if (uses_tree(allocator)) return alloc_best_fit(allocator, size, alignment, zeroed);
+        return alloc_first_fit(allocator, size, alignment, zeroed);
+    };
+
+    void* ptr = try_alloc();
+    // cached blocks only serve their own size, merged back they may serve this one
+    if (ptr == nullptr && allocator.cached_bytes != 0) {
+        flush_cached(allocator);
+        ptr = try_alloc();
+    }
+    if (ptr == nullptr && allocator.growable && grow(allocator, size, alignment)) ptr = try_alloc();
+
+    ALLOC_STAT(ptr != nullptr ? allocator.counters.alloc_count++ : allocator.counters.failed_allocs++);
+    return ptr;
+
+}
+
+// alloc_sized hands out a slot for these, anything else gets a block with a header
+bool slotted(const Allocator& allocator, size_t size, size_t alignment) {
+    return allocator.size_classes && size <= SIZE_CLASS_LIMIT && alignment <= MIN_ALIGNMENT;
+}
+
+size_t size_class_of(size_t size) {
+    return size == 0 ? 0 : (size - 1) / MIN_ALIGNMENT;
+}
+
+// cuts a fresh chunk into slots of size_class, false when the arena (and growth) runs out
+bool refill_size_class(Allocator& allocator, size_t size_class) {
+    uint8_t* chunk = (uint8_t*) allocate(allocator, SIZE_CLASS_CHUNK, MIN_ALIGNMENT, nullptr);
+    if (chunk == nullptr) return false;
+
+    // threaded back to front, so the slots go out in address order
+    size_t slot_size = (size_class + 1) * MIN_ALIGNMENT;
+    void* top = allocator.size_class_slots[size_class];
+    for (size_t offset = SIZE_CLASS_CHUNK / slot_size * slot_size; offset != 0;) {
+        offset -= slot_size;
+        *(void**) (chunk + offset) = top;
+        top = chunk + offset;
+    }
+    allocator.size_class_slots[size_class] = top;
+    allocator.size_class_bytes += SIZE_CLASS_CHUNK;
+    return true;
+}
+
+#ifdef __SSE2__
+// the streaming loops copy src (or clear, when src is nullptr) size bytes, a multiple of 64, to
+// dst, which is 32 byte aligned. the stores bypass the cache: a block this big is rarely read
+// again right away and would only push everything else out
+using StreamLoop = void (*)(uint8_t* dst, const uint8_t* src, size_t size);
+
+void stream_sse2(uint8_t* dst, const uint8_t* src, size_t size) {
+    if (src == nullptr) {
+        __m128i zero = _mm_setzero_si128();
+        for (size_t i = 0; i < size; i += 64) {
+            _mm_stream_si128((__m128i*) (dst + i), zero);
+            _mm_stream_si128((__m128i*) (dst + i + 16), zero);
+            _mm_stream_si128((__m128i*) (dst + i + 32), zero);
+            _mm_stream_si128((__m128i*) (dst + i + 48), zero);
+        }
+        return;
+    }
+    for (size_t i = 0; i < size; i += 64) {
+        __m128i a = _mm_loadu_si128((const __m128i*) (src + i));
+        __m128i b = _mm_loadu_si128((const __m128i*) (src + i + 16));
+        __m128i c = _mm_loadu_si128((const __m128i*) (src + i + 32));
+        __m128i d = _mm_loadu_si128((const __m128i*) (src + i + 48));
+        _mm_stream_si128((__m128i*) (dst + i), a);
+        _mm_stream_si128((__m128i*) (dst + i + 16), b);
+        _mm_stream_si128((__m128i*) (dst + i + 32), c);
+        _mm_stream_si128((__m128i*) (dst + i + 48), d);
+    }
+}
+
+__attribute__((target("avx2"))) void stream_avx2(uint8_t* dst, const uint8_t* src, size_t size) {
+    if (src == nullptr) {
+        __m256i zero = _mm256_setzero_si256();
+        for (size_t i = 0; i < size; i += 64) {
+            _mm256_stream_si256((__m256i*) (dst + i), zero);
+            _mm256_stream_si256((__m256i*) (dst + i + 32), zero);
+        }
+        return;
+    }
+    for (size_t i = 0; i < size; i += 64) {
+        __m256i a = _mm256_loadu_si256((const __m256i*) (src + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*) (src + i + 32));
+        _mm256_stream_si256((__m256i*) (dst + i), a);
+        _mm256_stream_si256((__m256i*) (dst + i + 32), b);
+    }
+}
+
+// picked on first use rather than by a static initializer, the preload malloc can get here
+// before this file's initializers ran
+std::atomic<StreamLoop> stream_loop{nullptr};
+
+StreamLoop pick_stream_loop() {
+    StreamLoop loop = stream_loop.load(std::memory_order_relaxed);
+    if (loop != nullptr) return loop;
+    __builtin_cpu_init();
+    loop = __builtin_cpu_supports("avx2") ? stream_avx2 : stream_sse2;
+    stream_loop.store(loop, std::memory_order_relaxed);
+    return loop;
+}
+
+// lines the destination up for the loop and does the ragged ends with memcpy / memset
+void stream(uint8_t* dst, const uint8_t* src, size_t size) {
+    size_t head = std::min((32 - ((uintptr_t) dst & 31)) & 31, size);
+    if (src != nullptr) std::memcpy(dst, src, head);
+    else std::memset(dst, 0, head);
+    dst += head;
+    if (src != nullptr) src += head;
+    size -= head;
+
+    size_t bulk = size & ~(size_t)63;
+    pick_stream_loop()(dst, src, bulk);
+    _mm_sfence(); // streaming stores are weakly ordered, make them visible before the block is handed out
+
+    if (src != nullptr) std::memcpy(dst + bulk, src + bulk, size - bulk);
+    else std::memset(dst + bulk, 0, size - bulk);
+}
+#endif
+
+void clear(void* memory, size_t size) {
+#ifdef __SSE2__
+    if (size >= STREAM_THRESHOLD) return stream((uint8_t*) memory, nullptr, size);
+#endif
+    std::memset(memory, 0, size);
+}
+
+void copy(void* dst, const void* src, size_t size) {
+#ifdef __SSE2__
+    if (size >= STREAM_THRESHOLD) return stream((uint8_t*) dst, (const uint8_t*) src, size);
+#endif
+    std::memcpy(dst, src, size);
+}
+
+// the moving half of realloc. the whole pages of a big page aligned payload in an mmap backed
+// arena are moved to a page aligned new block with mremap, only the partial last page is copied
+void* relocate(Allocator& allocator, void* ptr, size_t old_size, size_t new_size) {
+    size_t page = Pages::page_size();
+    if (allocator.mmap_backed && old_size >= REMAP_THRESHOLD && ((uintptr_t) ptr & (page - 1)) == 0) {
+        uint8_t* new_ptr = (uint8_t*) allocate(allocator, new_size, page, nullptr);
+        if (new_ptr != nullptr) {
+            size_t moved = old_size & ~(page - 1);
+            if (!Pages::remap(ptr, new_ptr, moved)) moved = 0;
+            copy(new_ptr + moved, (uint8_t*) ptr + moved, old_size - moved);
+            free(allocator, ptr);
+            return new_ptr;
+        }
+    }
+
+    void* new_ptr = allocate(allocator, new_size, MIN_ALIGNMENT, nullptr);
+    if (new_ptr == nullptr) return nullptr;
+    copy(new_ptr, ptr, old_size);
+    free(allocator, ptr);
+    return new_ptr;
+}
+
+}
+
+bool init(Allocator& allocator, size_t total_size, FitPolicy policy) {
+    Options options;
+    options.policy = policy;
+    return init(allocator, total_size, options);
+}
+
+bool init(Allocator& allocator, size_t total_size, const Options& options) {
+        void* raw_memory = options.mmap_backed ? Pages::reserve(total_size, options.huge_pages) : std::malloc(total_size);
+        if (raw_memory == nullptr) return false;
+
+        Options memory_options = options;
+        memory_options.zeroed_memory = options.mmap_backed; // a fresh mapping is, malloc's memory may not be
+        if (!init(allocator, raw_memory, total_size, memory_options)) {
+            if (options.mmap_backed) Pages::release(raw_memory, total_size);
+            else std::free(raw_memory);
+            return false;
+        }
+        allocator.owns_memory = true;
+        allocator.mmap_backed = options.mmap_backed;
+        return true;
+}
+
+bool init(Allocator& allocator, void* raw_memory, size_t total_size, const Options& options) {
+        allocator.policy = options.policy;
+        allocator.compact_headers = options.compact_headers && total_size < COMPACT_ARENA_LIMIT;
+        allocator.header_size = allocator.compact_headers ? sizeof(size_t) : sizeof(AllocationHeader);
+        allocator.free_list = nullptr;
+        allocator.bin_bitmap = 0;
+        std::fill(allocator.bins, allocator.bins + BIN_COUNT, nullptr);
+        allocator.tree_root = nullptr;
+        allocator.front_cache = options.front_cache;
+        allocator.front_cache_limit = options.front_cache_bytes;
+        allocator.cached_bytes = 0;
+        std::fill(allocator.cache_stacks, allocator.cache_stacks + FRONT_CACHE_CLASSES, nullptr);
+        allocator.size_classes = options.size_classes;
+        allocator.size_class_bytes = 0;
+        std::fill(allocator.size_class_slots, allocator.size_class_slots + SIZE_CLASS_COUNT, nullptr);
+        ALLOC_STAT(allocator.counters = Counters{});
+
+        allocator.memory = raw_memory;
+        allocator.capacity = total_size;
+        allocator.owns_memory = false;
+        allocator.mmap_backed = false; // only set for memory we mapped ourselves
+        allocator.mmap_regions = options.mmap_backed;
+        allocator.growable = options.growable;
+        allocator.release_empty_regions = options.release_empty_regions;
+        allocator.max_region_size = options.max_region_size;
+        allocator.regions = nullptr;
+        allocator.region_table = nullptr;
+        allocator.region_table_count = 0;
+        allocator.region_table_capacity = 0;
+
+        // ensure the initial memory is aligned to allow Node storage
+        uintptr_t current_addr = (uintptr_t) raw_memory;
+
+        // round up the to next alignment of Node
+        uintptr_t aligned_addr = (current_addr + alignof(Node) - 1) & ~(alignof(Node) - 1);
+
+        // the last aligned word is the sentinel
+        uintptr_t end_addr = ((current_addr + total_size) & ~(alignof(Node) - 1)) - sizeof(size_t);
+
+        if (end_addr < aligned_addr || end_addr - aligned_addr < MIN_BLOCK_SIZE) {
+            allocator.memory = nullptr;
+            allocator.capacity = 0;
+            return false; // memory too small to hold even one node
+        }
+
+        tag((void*) end_addr) = BLOCK_USED;
+
+        Node* first = (Node*) aligned_addr;
+        first->block_size = end_addr - aligned_addr;
+        release_block(allocator, first, first->block_size);
+        if (options.zeroed_memory) tag(first) |= BLOCK_ZERO;
+
+        allocator.next_region_size = std::min(total_size * 2, allocator.max_region_size);
+        return true;
+
+}
+
+void* alloc(Allocator& allocator, size_t size, size_t alignment) {
+    return allocate(allocator, size, alignment, nullptr);
+}
+
+void* calloc(Allocator& allocator, size_t count, size_t size, size_t alignment) {
+    size_t total;
+    if (__builtin_mul_overflow(count, size, &total)) return nullptr;
+
+    bool zeroed = false;
+    uint8_t* ptr = (uint8_t*) allocate(allocator, total, alignment, &zeroed);
+    if (ptr == nullptr) return nullptr;
+
+    if (!zeroed) {
+        clear(ptr, total);
+        return ptr;
+    }
+
+    // only the links at the front and the footer at the back of the old free block were written
+    uint8_t* block = (uint8_t*) header_of(allocator, ptr);
+    uint8_t* end = ptr + total;
+    uint8_t* links_end = block + FREE_HEADER_SIZE;
+    if (ptr < links_end) std::memset(ptr, 0, std::min(links_end, end) - ptr);
+    uint8_t* footer = block + used_block_size(allocator, block) - sizeof(size_t);
+    if (footer < end) std::memset(std::max(footer, ptr), 0, end - std::max(footer, ptr));
+    return ptr;
 }
 
 void free(Allocator& allocator, void* ptr) {
     if (ptr == nullptr) return;
 
     assert(allocator.memory != nullptr && "allocator memory base must be initialized");
-    uint8_t* allocator_memory = (uint8_t*)allocator.memory;
-    assert(
-        allocator_memory <= (uint8_t*)ptr  && (uint8_t*)ptr < (allocator_memory + allocator.capacity) &&
-        "pointer passed to free is outside allocator range"
-    );
+    assert(owns(allocator, ptr) && "pointer passed to free is outside allocator range");
 
-    AllocationHeader* header = (AllocationHeader*)((uint8_t*)ptr - sizeof(AllocationHeader));
-    // std::cout << "header inside free() is " << (uintptr_t)header << std::endl;
-    Node* node = (Node*) ((uint8_t*)header - header->padding);
+    AllocationHeader* header = header_of(allocator, ptr);
+    if (allocator.front_cache && push_cached(allocator, header, ptr)) return;
+    release_used_block(allocator, header);
 
-    size_t physical_size = header->block_size + header->padding + sizeof(AllocationHeader);
-    node->block_size = physical_size - sizeof(Node);
+}
 
-    Node* prev = nullptr;
-    Node* curr = allocator.free_list;
+void* alloc_sized(Allocator& allocator, size_t size, size_t alignment) {
+    if (!slotted(allocator, size, alignment)) return allocate(allocator, size, alignment, nullptr);
 
-    // find position such that prev < node < curr
-    while ( curr != nullptr && (uint8_t*) curr < (uint8_t*) node) { // need to convert to uint8_t* for pointer arithmetic
-        prev = curr;
-        curr = curr->next;
+    size_t size_class = size_class_of(size);
+    void*& top = allocator.size_class_slots[size_class];
+    if (top == nullptr && !refill_size_class(allocator, size_class)) return nullptr;
+    void* ptr = top;
+    top = *(void**) ptr;
+    return ptr;
+}
+
+void free_sized(Allocator& allocator, void* ptr, size_t size, size_t alignment) {
+    if (ptr == nullptr) return;
+
+    // the size picks the class, nothing around the slot is read
+    if (slotted(allocator, size, alignment)) {
+        assert(owns(allocator, ptr) && "pointer passed to free_sized is outside allocator range");
+        void*& top = allocator.size_class_slots[size_class_of(size)];
+        *(void**) ptr = top;
+        top = ptr;
+        return;
     }
 
-    if (prev == nullptr) {
-        node->next = allocator.free_list;
-        allocator.free_list = node;
-    } else {
-        prev->next = node;
-        node->next = curr;
+    // only blocks without front padding have their header at a fixed distance
+    if (alignment > MIN_ALIGNMENT) {
+        free(allocator, ptr);
+        return;
     }
 
+    assert(owns(allocator, ptr) && "pointer passed to free_sized is outside allocator range");
+    AllocationHeader* header = (AllocationHeader*) ((uint8_t*) ptr - allocator.header_size);
+    assert(header == header_of(allocator, ptr) && "block was allocated with a bigger alignment");
+    assert(usableSize(allocator, ptr) >= size && "block is smaller than the size passed to free_sized");
+    (void)size; // only read by the assert
 
-    // join next
-    if (node->next != nullptr && ((uint8_t*) node + sizeof(Node) + node->block_size == (uint8_t*) node->next)) {
-        node->block_size += sizeof(Node) + node->next->block_size;
-        node->next = node->next->next;
+    if (allocator.front_cache && push_cached(allocator, header, ptr)) return;
+    release_used_block(allocator, header);
+}
+
+size_t alloc_batch(Allocator& allocator, size_t size, size_t alignment, void** out, size_t n) {
+    if (size > MAX_REQUEST_SIZE || alignment > MAX_REQUEST_SIZE) return 0;
+    size = std::max(size, MIN_ALLOC_SIZE);
+    alignment = std::max(alignment, MIN_ALIGNMENT);
+
+    size_t count = 0;
+    // the next pointer is read before a run is carved, the leftover it puts back is never revisited
+    auto take_from = [&](Node* head) {
+        for (Node* curr = head; curr != nullptr && count < n;) {
+            Node* next = curr->next;
+            ALLOC_STAT(allocator.counters.nodes_scanned++);
+            if (block_size(curr) >= compute_fit(allocator, curr, size, alignment).required_size) {
+                remove_free_block(allocator, curr);
+                count += carve_run(allocator, curr, size, alignment, out + count, n - count);
+            }
+            curr = next;
+        }
+    };
+
+    auto one_pass = [&]() {
+        if (allocator.policy == FitPolicy::FirstFit) {
+            take_from(allocator.free_list);
+            return;
+        }
+
+        uint64_t candidates = allocator.bin_bitmap & (~(uint64_t)0 << bin_index(allocator.header_size + size));
+        for (; candidates != 0 && count < n; candidates &= candidates - 1) {
+            take_from(allocator.bins[__builtin_ctzll(candidates)]);
+        }
+
+        // tree blocks one best fit at a time, a leftover goes back in and can be picked again
+        while (uses_tree(allocator) && count < n) {
+            TreeNode* node = tree_fit(allocator, size, alignment);
+            if (node == nullptr) break;
+            tree_remove(allocator, node);
+            count += carve_run(allocator, node, size, alignment, out + count, n - count);
+        }
+    };
+
+    one_pass();
+    if (count < n && allocator.cached_bytes != 0) {
+        flush_cached(allocator);
+        one_pass();
+    }
+    // one region for the whole shortfall, so a batch grows at most once
+    if (count < n && allocator.growable) {
+        size_t block = allocator.header_size + alignment + size;
+        if ((n - count) <= SIZE_MAX / 2 / block && grow(allocator, (n - count) * block, alignment)) one_pass();
     }
 
-    // join prev
-    if (prev != nullptr && (uint8_t*)prev + sizeof(Node) + prev->block_size == (uint8_t*) node) {
-        prev->block_size += sizeof(Node) + node->block_size;
-        prev->next = node->next;
+    ALLOC_STAT(allocator.counters.alloc_count += count);
+    ALLOC_STAT(if (count < n) allocator.counters.failed_allocs++);
+    return count;
+}
+
+void free_batch(Allocator& allocator, void** ptrs, size_t n) {
+    std::sort(ptrs, ptrs + n); // nullptrs end up in front
+
+    size_t i = 0;
+    while (i < n && ptrs[i] == nullptr) i++;
+
+    while (i < n) {
+        assert(owns(allocator, ptrs[i]) && "pointer passed to free_batch is outside allocator range");
+        uint8_t* start = (uint8_t*) header_of(allocator, ptrs[i]);
+        assert(is_used(start) && "block already freed");
+        size_t span = used_block_size(allocator, start);
+        ALLOC_STAT(allocator.counters.free_count++);
+
+        // swallow every following block that starts right where the span ends
+        while (i + 1 < n && (uint8_t*) header_of(allocator, ptrs[i + 1]) == start + span) {
+            i++;
+            assert(is_used(start + span) && "block already freed");
+            span += used_block_size(allocator, start + span);
+            ALLOC_STAT(allocator.counters.free_count++);
+        }
+        i++;
+
+        ALLOC_STAT(allocator.counters.bytes_in_use -= span);
+        Node* node = release_block(allocator, (Node*) start, span);
+        if (allocator.release_empty_regions) release_if_empty(allocator, node);
     }
+}
 
+void flushFrontCache(Allocator& allocator) {
+    flush_cached(allocator);
 }
 
 void printFreeList(Allocator& allocator) {
     std::cout << "free list: " << std::endl;
 
-    Node* curr = allocator.free_list;
     int count = 0;
-    while (curr != nullptr) {
-        std::cout << "block: " << count++ << " , size = " << curr->block_size << " at " << (void*)curr << std::endl;
-        curr = curr->next;
+    if (allocator.policy != FitPolicy::FirstFit) {
+        for (size_t i = 0; i < BIN_COUNT; i++) {
+            for (Node* curr = allocator.bins[i]; curr != nullptr; curr = curr->next) {
+                std::cout << "bin: " << i << " block: " << count++ << " , size = " << block_size(curr) << " at " << (void*)curr << std::endl;
+            }
+        }
+        for (TreeNode* curr = tree_first(allocator); curr != nullptr; curr = tree_successor(curr)) {
+            std::cout << "tree block: " << count++ << " , size = " << block_size(curr) << " at " << (void*)curr << std::endl;
+        }
+    } else {
+        Node* curr = allocator.free_list;
+        while (curr != nullptr) {
+            std::cout << "block: " << count++ << " , size = " << block_size(curr) << " at " << (void*)curr << std::endl;
+            curr = curr->next;
+        }
     }
     if (count == 0) std::cout << "empty!" << std::endl;
 
@@ -189,6 +1160,83 @@ void printFreeList(Allocator& allocator) {
 
 }
 
+size_t trim(Allocator& allocator, size_t min_span) {
+    if (!allocator.owns_memory || !allocator.mmap_backed) return 0;
+
+    // the links at the front and the footer at the back have to survive. when the pages in
+    // between went at page granularity the block is zero again once the partial pages at both
+    // ends are cleared (a huge page fallback would leave too much to clear)
+    size_t trimmed = 0;
+    auto trim_block = [&](Node* node) {
+        size_t size = block_size(node);
+        if (size < min_span) return;
+
+        uint8_t* start = (uint8_t*) node + FREE_HEADER_SIZE;
+        uint8_t* end = (uint8_t*) node + size - sizeof(size_t);
+        size_t decommitted = Pages::decommit(start, end - start);
+        trimmed += decommitted;
+
+        uint8_t* first_page = (uint8_t*) (((uintptr_t) start + Pages::page_size() - 1) & ~(Pages::page_size() - 1));
+        uint8_t* last_page = (uint8_t*) ((uintptr_t) end & ~(Pages::page_size() - 1));
+        if (decommitted == 0 || decommitted != (size_t) (last_page - first_page)) return;
+        std::memset(start, 0, first_page - start);
+        std::memset(last_page, 0, end - last_page);
+        tag(node) |= BLOCK_ZERO;
+    };
+
+    for_each_free_block(allocator, trim_block);
+    return trimmed;
+}
+
+Stats getStats(const Allocator& allocator) {
+    Stats stats = {};
+#ifdef ALLOC_STATS
+    stats.counters = allocator.counters;
+    size_t attempts = stats.counters.alloc_count + stats.counters.failed_allocs;
+    if (attempts != 0) stats.avg_nodes_scanned = (double) stats.counters.nodes_scanned / attempts;
+#endif
+
+    auto count = [&](const Node* node) {
+        size_t size = block_size(node);
+        stats.free_bytes += size;
+        stats.free_block_count++;
+        stats.largest_free_block = std::max(stats.largest_free_block, size);
+        size_t bucket = std::min((size_t)(63 - __builtin_clzll(size)), STATS_HISTOGRAM_BUCKETS - 1);
+        stats.histogram[bucket]++;
+    };
+
+    for_each_free_block(allocator, count);
+
+    if (stats.free_bytes != 0) {
+        stats.fragmentation = 1.0 - (double) stats.largest_free_block / stats.free_bytes;
+    }
+
+    stats.cached_bytes = allocator.cached_bytes;
+    stats.size_class_bytes = allocator.size_class_bytes;
+    stats.region_count = 1;
+    stats.reserved_bytes = allocator.capacity;
+    for (const Region* region = allocator.regions; region != nullptr; region = region->next) {
+        stats.region_count++;
+        stats.reserved_bytes += region->size;
+    }
+    return stats;
+}
+
+bool owns(const Allocator& allocator, const void* ptr) {
+    const uint8_t* p = (const uint8_t*) ptr;
+    const uint8_t* memory = (const uint8_t*) allocator.memory;
+    if (memory <= p && p < memory + allocator.capacity) return true;
+
+    // the last region that starts at or below p is the only one that can hold it
+    size_t i = region_table_upper(allocator, p);
+    return i != 0 && p < allocator.region_table[i - 1].end;
+}
+
+size_t usableSize(Allocator& allocator, void* ptr) {
+    AllocationHeader* header = header_of(allocator, ptr);
+    return used_block_size(allocator, header) - allocator.header_size - padding_of(allocator, ptr);
+}
+
 void* realloc(Allocator& allocator, void* ptr, size_t new_size) {
 
     if (ptr == nullptr) return alloc(allocator, new_size, MIN_ALIGNMENT); // what alignment should i use here?
@@ -197,70 +1245,109 @@ void* realloc(Allocator& allocator, void* ptr, size_t new_size) {
         return nullptr;
     }
 
-    AllocationHeader* header = (AllocationHeader*) ((uint8_t*) ptr - sizeof(AllocationHeader));
-    size_t old_size = header->block_size;
+    ALLOC_STAT(allocator.counters.realloc_count++);
+    if (new_size > MAX_REQUEST_SIZE) return nullptr; // the block stays as it is
 
+    AllocationHeader* header = header_of(allocator, ptr);
+    size_t physical = used_block_size(allocator, header);
+    size_t front = allocator.header_size + padding_of(allocator, ptr); // header + padding
+    size_t old_size = physical - front;
 
-    // we need to (ptr + new_size) to be aligned
 
+    // we need the block to end on an aligned address
     size_t required_alignment = alignof(Node);
+    size_t aligned_new_size = (std::max(new_size, MIN_ALLOC_SIZE) + required_alignment - 1) & ~(required_alignment - 1);
+    size_t new_physical = std::max(front + aligned_new_size, MIN_BLOCK_SIZE);
 
-    uintptr_t split_addr = (uintptr_t) ptr + new_size;
 
-    uintptr_t aligned_split_addr = (split_addr + required_alignment - 1) & ~(required_alignment - 1);
+    // shrink, free the extra space
+    if (new_physical < physical && physical - new_physical >= MIN_SPLIT_SIZE) {
 
-    size_t aligned_new_size = aligned_split_addr - (uintptr_t)ptr;
+        // turn the tail into its own block and give it back
+        Node* tail = (Node*) ((uint8_t*) header + new_physical);
+        tail->block_size = physical - new_physical; // prev (us) is used
+        set_used_block_size(allocator, header, new_physical);
+        ALLOC_STAT(allocator.counters.bytes_in_use -= physical - new_physical);
 
+        release_block(allocator, tail, tail->block_size);
 
-    // shrink, free the extra space
-    if (aligned_new_size < old_size && old_size - aligned_new_size >= MIN_SPLIT_SIZE) {
+        return ptr; // return the original memory, now with shrinked size
+
+        // grow, try to take over the next block first
+        // otherwise allocate a new block, copy the data, and free the old one
+    } else if (new_size > old_size) {
 
-        // ill try to convert the remaining block
-        // as if its an allocated block and then send it to free
+        if (try_expand(allocator, ptr, new_size)) return ptr;
+
+        return relocate(allocator, ptr, old_size, new_size); // nullptr on failed allocation
+    }
 
-        AllocationHeader* extra_memory_header = (AllocationHeader*)((uint8_t*) ptr + aligned_new_size);
-        // std::cout << "ptr is " << (uintptr_t)ptr << std::endl;
-        // std::cout << "[DEBUG] extra_memory_header is " << (uintptr_t)extra_memory_header << std::endl;
-        // std::cout << "is extra_memory header aligned? " << (((uintptr_t)extra_memory_header % 8) == 0) << std::endl;
-        // std::cout << "new size is " << new_size << std::endl;
-        // std::cout << " is ptr aligned" << ((uintptr_t)ptr % 8 == 0) << std::endl;
+    return ptr;
 
-        size_t total_extra_memory = old_size - aligned_new_size;
-        size_t usable_memory = total_extra_memory - sizeof(AllocationHeader);
+}
 
-        extra_memory_header->block_size = usable_memory;
-        extra_memory_header->padding = 0;
-        void* extra_memory = (void*)((uint8_t*) extra_memory_header + sizeof(AllocationHeader));
+bool try_expand(Allocator& allocator, void* ptr, size_t new_size) {
+    assert(ptr != nullptr);
+    if (new_size > MAX_REQUEST_SIZE) return false;
 
-        // std::cout << "is extra_memory aligned " << ((uintptr_t)extra_memory % 8 == 0) << std::endl;
-        // std::cout << "extra memory is " << (uintptr_t)extra_memory << std::endl;
-        free(allocator, extra_memory);
+    AllocationHeader* header = header_of(allocator, ptr);
+    size_t physical = used_block_size(allocator, header);
+    size_t front = allocator.header_size + padding_of(allocator, ptr);
+    size_t required = front + ((std::max(new_size, MIN_ALLOC_SIZE) + alignof(Node) - 1) & ~(alignof(Node) - 1));
 
-        header->block_size = aligned_new_size;
+    if (required <= physical) return true; // already big enough
 
-        return ptr; // return the original memory, now with shrinked size
+    uint8_t* next = (uint8_t*) header + physical;
+    if (is_used(next)) return false;
 
-        // grow, allocate a new block, copy the data, and free the old one
-    } else if (new_size > old_size) {
+    size_t combined = physical + block_size(next);
+    if (combined < required) return false;
 
-        void* new_ptr = alloc(allocator, new_size, MIN_ALIGNMENT);
-        if (new_ptr == nullptr) return nullptr; //failed allocation
-        std::memcpy(new_ptr, ptr, std::min(aligned_new_size, old_size));
-        free(allocator, ptr);
+    remove_free_block(allocator, (Node*) next);
 
-        return new_ptr;
+    size_t leftover = combined - required;
+    if (leftover >= MIN_SPLIT_SIZE) {
+        // split, the block after the tail already knows its prev is free
+        Node* tail = (Node*) ((uint8_t*) header + required);
+        tail->block_size = leftover;
+        write_footer(tail);
+        insert_free_block(allocator, tail);
+    } else {
+        required = combined;
+        tag((uint8_t*) header + combined) &= ~BLOCK_PREV_FREE;
     }
 
-    return ptr;
-
+    set_used_block_size(allocator, header, required);
+    ALLOC_STAT(add_in_use(allocator, required - physical));
+    return true;
 }
 
 void destroy(Allocator& allocator) {
+    Region* region = allocator.regions;
+    while (region != nullptr) {
+        Region* next = region->next; // the header goes away with its region
+        unmap_region_memory(allocator, region->memory, region->size);
+        region = next;
+    }
+    allocator.regions = nullptr;
+    if (allocator.region_table != nullptr) Pages::release(allocator.region_table, allocator.region_table_capacity * sizeof(RegionSpan));
+    allocator.region_table = nullptr;
+    allocator.region_table_count = 0;
+    allocator.region_table_capacity = 0;
+
     if (allocator.memory) {
-        std::free(allocator.memory);
+        if (allocator.owns_memory && allocator.mmap_backed) Pages::release(allocator.memory, allocator.capacity);
+        else if (allocator.owns_memory) std::free(allocator.memory);
         allocator.memory = nullptr;
         allocator.capacity = 0;
         allocator.free_list = nullptr;
+        allocator.bin_bitmap = 0;
+        std::fill(allocator.bins, allocator.bins + BIN_COUNT, nullptr);
+        allocator.tree_root = nullptr;
+        allocator.cached_bytes = 0;
+        std::fill(allocator.cache_stacks, allocator.cache_stacks + FRONT_CACHE_CLASSES, nullptr);
+        allocator.size_class_bytes = 0;
+        std::fill(allocator.size_class_slots, allocator.size_class_slots + SIZE_CLASS_COUNT, nullptr);
     }
 }
 }
@@ -6,24 +6,219 @@
 #include <stdint.h>
 #include <sys/types.h>
 
+#include "PageMemory.h"
 #include "types.h"
 
 namespace FreeList {
+
+enum class FitPolicy {
+    FirstFit,   // one list, take the first block that fits
+    Segregated, // size-class bins + bitmap of non-empty bins
+    // the smallest block that fits. blocks under SMALL_BIN_LIMIT sit in the exact size bins,
+    // bigger ones in a tree ordered by size (a treap, so O(log n) expected per lookup)
+    BestFit,
+    // like BestFit, but blocks of the same size in the tree are ordered by address too and the
+    // lowest one is taken, which packs live data towards the front of the arena
+    AddressOrderedBestFit,
+};
+
+// bins 0..SMALL_BIN_COUNT-1 hold blocks in 8 byte steps below SMALL_BIN_LIMIT,
+// the rest hold one power of two each
+const size_t BIN_COUNT = 64;
+const size_t SMALL_BIN_COUNT = 32;
+const size_t SMALL_BIN_LIMIT = SMALL_BIN_COUNT * MIN_ALIGNMENT;
+
+// one front cache stack per physical block size below SMALL_BIN_LIMIT, in 8 byte steps
+const size_t FRONT_CACHE_CLASSES = SMALL_BIN_COUNT;
+
+// header-less slots for alloc_sized, class i serves (i + 1) * MIN_ALIGNMENT bytes.
+// a class that runs dry carves SIZE_CLASS_CHUNK bytes out of the arena into slots
+const size_t SIZE_CLASS_LIMIT = SMALL_BIN_LIMIT;
+const size_t SIZE_CLASS_COUNT = SIZE_CLASS_LIMIT / MIN_ALIGNMENT;
+const size_t SIZE_CLASS_CHUNK = 4096;
+
+struct Options {
+    FitPolicy policy = FitPolicy::FirstFit;
+    // pack size + flags and padding into 32 bits each, so a used block only spends 8 bytes on its header.
+    // only honoured for arenas under 4 GiB, bigger ones keep the full AllocationHeader
+    bool compact_headers = false;
+    // take the arena from mmap instead of malloc: pages commit lazily and trim can hand free
+    // spans back to the OS. huge_pages only applies to mmap backed arenas. for an arena over
+    // caller memory it only means grown regions are mapped, so growth never calls malloc
+    bool mmap_backed = false;
+    Pages::HugePages huge_pages = Pages::HugePages::Off;
+    // map another region instead of failing when nothing fits. region sizes double (starting from
+    // the arena's) until they reach max_region_size, a bigger request gets a region of its own size
+    bool growable = false;
+    size_t max_region_size = 64 * 1024 * 1024;
+    // unmap a grown region as soon as free leaves it empty, the arena from init is always kept
+    bool release_empty_regions = false;
+    // keep freed small blocks (under SMALL_BIN_LIMIT, no front padding) on per size LIFO stacks
+    // and hand them straight back to the next alloc of that size. once more than
+    // front_cache_bytes are cached, or an alloc finds nothing else, all of them go back to the
+    // free structures to coalesce
+    bool front_cache = false;
+    size_t front_cache_bytes = 64 * 1024;
+    // the memory given to init is known to be zero (fresh mmap, .bss), so calloc can skip clearing
+    // it. owned mmap backed arenas and their grown regions are always treated that way
+    bool zeroed_memory = false;
+    // alloc_sized serves sizes up to SIZE_CLASS_LIMIT (alignment up to MIN_ALIGNMENT) from
+    // header-less slots, so free_sized finds the slot's class from the size alone and never reads
+    // a header. chunks given to the slots stay used blocks until destroy, like a PoolSet's
+    bool size_classes = false;
+};
+
+// a region added by growth: [blocks ...][sentinel][Region]. the header sits at the end so the
+// sentinel a free block runs into leads straight to it
+struct Region {
+    Region* next;
+    Region* prev;
+    void* memory; // start of the mapping, the first block starts here
+    size_t size;  // of the whole mapping
+};
+
+// one entry of the table owns searches, [start, end) is the region's whole mapping
+struct RegionSpan {
+    const uint8_t* start;
+    const uint8_t* end;
+};
+
+// free blocks of the tree policies that are too big for a small bin, see FreeListAllocator.cpp
+struct TreeNode;
+
+// trim leaves free blocks smaller than this alone
+const size_t TRIM_MIN_SPAN = 64 * 1024;
+
+const size_t STATS_HISTOGRAM_BUCKETS = 32;
+
+// counters kept up to date by every call when built with ALLOC_STATS
+struct Counters {
+    size_t bytes_in_use; // physical size of all used blocks, headers and padding included
+    size_t peak_bytes_in_use;
+    size_t alloc_count;
+    size_t free_count;
+    size_t realloc_count;
+    size_t failed_allocs;
+    size_t nodes_scanned; // free blocks looked at by alloc
+};
+
+// snapshot from getStats, plain data so it can be exported as is
+struct Stats {
+    Counters counters; // all zero without ALLOC_STATS
+    double avg_nodes_scanned; // per successful or failed alloc
+
+    // these come from walking the free blocks, so they work without ALLOC_STATS too
+    size_t free_bytes;
+    size_t free_block_count;
+    size_t largest_free_block;
+    double fragmentation; // external fragmentation, 1 - largest_free_block / free_bytes
+    size_t histogram[STATS_HISTOGRAM_BUCKETS]; // free blocks by size, bucket i holds sizes in [2^i, 2^(i+1))
+
+    size_t region_count;   // the arena from init plus every grown region
+    size_t reserved_bytes; // their total size
+
+    size_t cached_bytes; // blocks waiting in the front cache, counted neither as free nor in use
+    size_t size_class_bytes; // chunks carved into size class slots, in use as far as the arena is concerned
+};
+
 struct Allocator {
-    void* memory;
+    void* memory; // the arena from init, grown regions are in regions
     size_t capacity;
-    Node* free_list;
+    Node* free_list; // used by FitPolicy::FirstFit
+    FitPolicy policy;
+    bool compact_headers;
+    bool owns_memory; // memory came from init's malloc or mmap, destroy gives it back
+    bool mmap_backed;
+    bool mmap_regions; // grown regions come from mmap, set for every mmap_backed Options
+    bool growable;
+    bool release_empty_regions;
+    size_t next_region_size;
+    size_t max_region_size;
+    Region* regions; // grown regions, newest first
+    RegionSpan* region_table; // the same regions sorted by address, in pages of their own
+    size_t region_table_count;
+    size_t region_table_capacity;
+    size_t header_size; // bytes in front of the padding of every used block
+    uint64_t bin_bitmap; // bit i is set when bins[i] is non-empty
+    Node* bins[BIN_COUNT]; // used by FitPolicy::Segregated, the small ones by the tree policies too
+    TreeNode* tree_root; // used by FitPolicy::BestFit and FitPolicy::AddressOrderedBestFit
+    bool front_cache;
+    size_t front_cache_limit;
+    size_t cached_bytes;
+    void* cache_stacks[FRONT_CACHE_CLASSES]; // payloads of cached blocks, linked through their first word
+    bool size_classes;
+    size_t size_class_bytes;
+    void* size_class_slots[SIZE_CLASS_COUNT]; // free slots, linked through their first word
+#ifdef ALLOC_STATS
+    Counters counters;
+#endif
 };
 
-bool init(Allocator& allocator, size_t total_size);
+bool init(Allocator& allocator, size_t total_size, FitPolicy policy = FitPolicy::FirstFit);
+
+bool init(Allocator& allocator, size_t total_size, const Options& options);
+
+// builds the arena in memory the caller provides (and keeps owning), destroy leaves it alone.
+// never calls malloc, so it can back a malloc replacement
+bool init(Allocator& allocator, void* memory, size_t total_size, const Options& options = Options());
 
 void* alloc(Allocator& allocator, size_t size, size_t alignment);
 
+// count * size zeroed bytes, nullptr on overflow. a block carved from memory that was never
+// handed out (or came back from trim) is already zero, only the words the free structures
+// wrote into it get cleared, so its untouched pages stay uncommitted
+void* calloc(Allocator& allocator, size_t count, size_t size, size_t alignment = MIN_ALIGNMENT);
+
 void free(Allocator& allocator, void* ptr);
 
+// alloc for callers that free with free_sized. with Options::size_classes a small request
+// (see SIZE_CLASS_LIMIT) gets a header-less slot, which only free_sized can give back:
+// free, usableSize and realloc must not see it. anything else is a plain alloc
+void* alloc_sized(Allocator& allocator, size_t size, size_t alignment);
+
+// free for callers that know what they allocated: size and alignment as passed to alloc_sized
+// (or to alloc, in an arena without size_classes). a slot goes straight back on its class's stack. a block with no front padding (up
+// to MIN_ALIGNMENT) has its header found by subtraction instead of through the padding word
+// in front of ptr, one dependent load less. bigger alignments take the normal free path
+void free_sized(Allocator& allocator, void* ptr, size_t size, size_t alignment);
+
+// n blocks of the same size in one pass over the free blocks: every free block that is picked
+// is cut into as many of them as it holds. fills out[0..count) and returns count, which is less
+// than n only when the arena (and growth) runs out
+size_t alloc_batch(Allocator& allocator, size_t size, size_t alignment, void** out, size_t n);
+
+// frees n blocks at once (nullptrs are skipped). ptrs is sorted by address in place, so blocks
+// that sit next to each other are merged into one span and handed back with a single release
+void free_batch(Allocator& allocator, void** ptrs, size_t n);
+
+// gives every block in the front cache back to the free structures
+void flushFrontCache(Allocator& allocator);
+
 void printFreeList(Allocator& allocator);
 
+// decommits the whole pages inside every free block of at least min_span bytes, so RSS drops
+// after a load spike. the blocks stay free and usable, their pages come back zeroed when touched.
+// only mmap backed arenas are trimmed. returns the bytes decommitted
+size_t trim(Allocator& allocator, size_t min_span = TRIM_MIN_SPAN);
+
+// walks the free blocks, O(free blocks)
+Stats getStats(const Allocator& allocator);
+
+// true when ptr lies in the arena or one of its grown regions, O(log regions)
+bool owns(const Allocator& allocator, const void* ptr);
+
+// bytes the block at ptr can hold (at least what was asked for)
+size_t usableSize(Allocator& allocator, void* ptr);
+
+// shrinks and grows in place when it can. a move copies big payloads with streaming stores, and
+// in an mmap backed arena moves the pages of a page aligned payload of 2 MiB and up with mremap
+// (the new block is page aligned too)
 void* realloc(Allocator& allocator, void* ptr, size_t new_size);
 
+// grows the block at ptr in place by absorbing the free block physically after it,
+// never moves. returns true when ptr can now hold new_size bytes
+bool try_expand(Allocator& allocator, void* ptr, size_t new_size);
+
+// releases the arena (unless it was provided by the caller) and every grown region
 void destroy(Allocator& allocator);
 }
@@ -1,15 +1,76 @@
 #include "LinearAllocator.h"
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
 
 namespace Linear {
-    bool init(Allocator& allocator, size_t total_size) {
-        allocator.memory = std::malloc(total_size);
-        if (allocator.memory == nullptr) {
+    namespace {
+        size_t header_size(const Allocator& allocator) {
+            return allocator.options.headers ? sizeof(AllocationHeader) : 0;
+        }
+
+        Chunk* new_chunk(const Options& options, size_t capacity) {
+            size_t total_size = sizeof(Chunk) + capacity;
+            Chunk* chunk = (Chunk*) (options.mmap_backed ? Pages::reserve(total_size, options.huge_pages) : std::malloc(total_size));
+            if (chunk == nullptr) return nullptr;
+            chunk->next = nullptr;
+            chunk->capacity = total_size - sizeof(Chunk); // mappings round up to whole pages
+            return chunk;
+        }
+
+        void delete_chunk(const Options& options, Chunk* chunk) {
+            if (options.mmap_backed) Pages::release(chunk, sizeof(Chunk) + chunk->capacity);
+            else std::free(chunk);
+        }
+
+        void use_chunk(Allocator& allocator, Chunk* chunk) {
+            allocator.current = chunk;
+            allocator.memory = chunk + 1;
+            allocator.capacity = chunk->capacity;
+            allocator.offset = 0;
+        }
+
+        // moves on to a chunk that can take size bytes at alignment, reusing cached ones
+        bool advance(Allocator& allocator, size_t size, size_t alignment) {
+            size_t needed = header_size(allocator) + size + alignment - 1;
+            Chunk* current = allocator.current;
+
+            allocator.used_before += allocator.offset;
+
+            // chunks cached by reset come first
+            if (current->next != nullptr && current->next->capacity >= needed) {
+                use_chunk(allocator, current->next);
+                return true;
+            }
+
+            // grow geometrically, but always enough for this request
+            size_t capacity = std::min(current->capacity * 2, allocator.options.max_chunk_size);
+            capacity = std::max(capacity, needed);
+
+            Chunk* chunk = new_chunk(allocator.options, capacity);
+            if (chunk == nullptr) {
+                allocator.used_before -= allocator.offset;
+                return false;
+            }
+
+            chunk->next = current->next;
+            current->next = chunk;
+            use_chunk(allocator, chunk);
+            return true;
+        }
+    }
+
+    bool init(Allocator& allocator, size_t total_size, const Options& options) {
+        allocator.options = options;
+        allocator.used_before = 0;
+        ALLOC_STAT(allocator.counters = Counters{});
+        allocator.first = new_chunk(options, total_size);
+        if (allocator.first == nullptr) {
+            allocator.current = nullptr;
+            allocator.memory = nullptr;
             return false;
         }
-        allocator.capacity = total_size;
-        allocator.offset = 0;
+        use_chunk(allocator, allocator.first);
         return true;
     }
 
@@ -17,15 +78,27 @@ namespace Linear {
 
         assert((alignment != 0) && ((alignment & (alignment - 1)) == 0) && "alignment must be a power of 2");
 
-        uintptr_t addr = (uintptr_t)allocator.memory + allocator.offset + sizeof(AllocationHeader);
+        size_t header_bytes = header_size(allocator);
+
+        uintptr_t addr = (uintptr_t)allocator.memory + allocator.offset + header_bytes;
 
         uintptr_t aligned_addr = (addr + alignment - 1) & ~(alignment - 1); // gets the aligned address
 
         uintptr_t padding = aligned_addr - addr; // padding
 
-        if (allocator.offset + sizeof(AllocationHeader) + padding + size > allocator.capacity) return nullptr;
+        if (allocator.offset + header_bytes + padding + size > allocator.capacity) {
+            if (!allocator.options.growable || !advance(allocator, size, alignment)) {
+                ALLOC_STAT(allocator.counters.failed_allocs++);
+                return nullptr;
+            }
+            return alloc(allocator, size, alignment); // fits in the new chunk
+        }
 
-        allocator.offset += sizeof(AllocationHeader) + padding + size;
+        allocator.offset += header_bytes + padding + size;
+        ALLOC_STAT(allocator.counters.alloc_count++);
+        ALLOC_STAT(allocator.counters.peak_bytes_in_use = std::max(allocator.counters.peak_bytes_in_use, getUsed(allocator)));
+
+        if (!allocator.options.headers) return (void*)aligned_addr;
 
         AllocationHeader* header = (AllocationHeader*) (aligned_addr - sizeof(AllocationHeader));
         header->block_size = size;
@@ -36,28 +109,166 @@ namespace Linear {
     }
 
     void free(Allocator& allocator, void* ptr) {
-        (void)allocator;
+        if (ptr == nullptr || !allocator.options.headers) return;
+
         AllocationHeader* header = (AllocationHeader*)((uint8_t*)ptr - sizeof(AllocationHeader));
-        std::cout << "block_size is " << header->block_size << std::endl;
-        std::cout << "padding is " << +header->padding << std::endl;
+        uint8_t* memory = (uint8_t*)allocator.memory;
+
+        // only the top of the current chunk can be popped
+        if ((uint8_t*)ptr + header->block_size != memory + allocator.offset) return;
+
+        allocator.offset = ((uint8_t*)header - header->padding) - memory;
     }
 
     void destroy(Allocator& allocator) {
-        if (allocator.memory) {
-            std::free(allocator.memory);
-            allocator.memory = nullptr;
+        Chunk* chunk = allocator.first;
+        while (chunk != nullptr) {
+            Chunk* next = chunk->next;
+            delete_chunk(allocator.options, chunk);
+            chunk = next;
         }
+        allocator.first = nullptr;
+        allocator.current = nullptr;
+        allocator.memory = nullptr;
     }
 
     void reset(Allocator& allocator) {
-        allocator.offset = 0;
+        if (allocator.first != nullptr) use_chunk(allocator, allocator.first);
+        allocator.used_before = 0;
+        ALLOC_STAT(allocator.counters.reset_count++);
+    }
+
+    size_t trim(Allocator& allocator) {
+        if (!allocator.options.mmap_backed || allocator.current == nullptr) return 0;
+
+        uint8_t* memory = (uint8_t*)allocator.memory;
+        size_t trimmed = Pages::decommit(memory + allocator.offset, allocator.capacity - allocator.offset);
+        for (Chunk* chunk = allocator.current->next; chunk != nullptr; chunk = chunk->next) {
+            trimmed += Pages::decommit(chunk + 1, chunk->capacity);
+        }
+        return trimmed;
+    }
+
+    bool owns(const Allocator& allocator, const void* ptr) {
+        for (Chunk* chunk = allocator.first; chunk != nullptr; chunk = chunk->next) {
+            uint8_t* memory = (uint8_t*)(chunk + 1);
+            if (memory <= (const uint8_t*)ptr && (const uint8_t*)ptr < memory + chunk->capacity) return true;
+        }
+        return false;
+    }
+
+    Marker getMarker(const Allocator& allocator) {
+        return Marker{allocator.current, allocator.offset, allocator.used_before};
+    }
+
+    void rollbackTo(Allocator& allocator, const Marker& marker) {
+        assert(marker.chunk != nullptr && "marker from an uninitialized arena");
+        if (marker.chunk != allocator.current) use_chunk(allocator, marker.chunk);
+        allocator.offset = marker.offset;
+        allocator.used_before = marker.used_before;
+        ALLOC_STAT(allocator.counters.reset_count++);
     }
 
     size_t getUsed(const Allocator& allocator) {
-        return allocator.offset;
+        return allocator.used_before + allocator.offset;
     }
 
     size_t getAvailable(const Allocator& allocator) {
-        return allocator.capacity - allocator.offset;
+        // what is left here plus every cached chunk after it
+        size_t available = allocator.capacity - allocator.offset;
+        if (allocator.current != nullptr) {
+            for (Chunk* chunk = allocator.current->next; chunk != nullptr; chunk = chunk->next) {
+                available += chunk->capacity;
+            }
+        }
+        return available;
+    }
+
+    Stats getStats(const Allocator& allocator) {
+        Stats stats = {};
+#ifdef ALLOC_STATS
+        stats.counters = allocator.counters;
+#endif
+        stats.bytes_in_use = getUsed(allocator);
+        for (Chunk* chunk = allocator.first; chunk != nullptr; chunk = chunk->next) {
+            stats.chunk_count++;
+            stats.reserved_bytes += chunk->capacity;
+        }
+        return stats;
+    }
+
+    bool init(DoubleEnded& allocator, size_t total_size) {
+        allocator.memory = std::malloc(total_size);
+        allocator.capacity = allocator.memory != nullptr ? total_size : 0;
+        allocator.low = 0;
+        allocator.high = allocator.capacity;
+        return allocator.memory != nullptr;
+    }
+
+    void* alloc(DoubleEnded& allocator, size_t size, size_t alignment, End end) {
+        assert((alignment != 0) && ((alignment & (alignment - 1)) == 0) && "alignment must be a power of 2");
+
+        uintptr_t base = (uintptr_t)allocator.memory;
+        if (end == End::Low) {
+            uintptr_t aligned_addr = (base + allocator.low + alignment - 1) & ~(alignment - 1);
+            size_t start = aligned_addr - base;
+            if (start > allocator.high || size > allocator.high - start) return nullptr;
+            allocator.low = start + size;
+            return (void*)aligned_addr;
+        }
+
+        // the high end grows down, so the padding ends up above the block
+        if (size > allocator.high - allocator.low) return nullptr;
+        uintptr_t aligned_addr = (base + allocator.high - size) & ~(alignment - 1);
+        if (aligned_addr < base + allocator.low) return nullptr;
+        allocator.high = aligned_addr - base;
+        return (void*)aligned_addr;
+    }
+
+    void free(DoubleEnded&, void*) {}
+
+    void reset(DoubleEnded& allocator, End end) {
+        if (end == End::Low) allocator.low = 0;
+        else allocator.high = allocator.capacity;
+    }
+
+    void reset(DoubleEnded& allocator) {
+        allocator.low = 0;
+        allocator.high = allocator.capacity;
+    }
+
+    size_t getMarker(const DoubleEnded& allocator, End end) {
+        return end == End::Low ? allocator.low : allocator.high;
+    }
+
+    void rollbackTo(DoubleEnded& allocator, End end, size_t marker) {
+        if (end == End::Low) {
+            assert(marker <= allocator.low && "marker is ahead of the low end");
+            allocator.low = marker;
+        } else {
+            assert(marker >= allocator.high && marker <= allocator.capacity && "marker is ahead of the high end");
+            allocator.high = marker;
+        }
+    }
+
+    size_t getUsed(const DoubleEnded& allocator, End end) {
+        return end == End::Low ? allocator.low : allocator.capacity - allocator.high;
+    }
+
+    size_t getAvailable(const DoubleEnded& allocator) {
+        return allocator.high - allocator.low;
+    }
+
+    bool owns(const DoubleEnded& allocator, const void* ptr) {
+        const uint8_t* memory = (const uint8_t*)allocator.memory;
+        return memory <= (const uint8_t*)ptr && (const uint8_t*)ptr < memory + allocator.capacity;
+    }
+
+    void destroy(DoubleEnded& allocator) {
+        std::free(allocator.memory);
+        allocator.memory = nullptr;
+        allocator.capacity = 0;
+        allocator.low = 0;
+        allocator.high = 0;
     }
 }
@@ -2,25 +2,161 @@
 
 #include <stdint.h>
 
+#include "PageMemory.h"
 #include "types.h"
 
 namespace Linear {
+    // chunks are chained in front of their memory, the first one comes from init
+    struct Chunk {
+        Chunk* next;
+        size_t capacity; // usable bytes after the chunk header
+    };
+
+    struct Options {
+        bool growable = false; // chain a new chunk instead of failing when the current one is full
+        size_t max_chunk_size = 64 * 1024 * 1024; // chunk sizes double until they reach this
+        // write an AllocationHeader before every allocation. only free needs it, arenas that are
+        // just reset or rolled back pack allocations back to back without one
+        bool headers = false;
+        // chunks come from mmap instead of malloc, their pages commit as the offset reaches them
+        // and trim can give the unused ones back
+        bool mmap_backed = false;
+        Pages::HugePages huge_pages = Pages::HugePages::Off;
+    };
+
+    // counters kept up to date by every call when built with ALLOC_STATS
+    struct Counters {
+        size_t peak_bytes_in_use; // high-water mark, survives reset and rollbackTo
+        size_t alloc_count;
+        size_t failed_allocs;
+        size_t reset_count; // reset and rollbackTo calls
+    };
+
+    // snapshot from getStats
+    struct Stats {
+        Counters counters; // all zero without ALLOC_STATS
+        size_t bytes_in_use;
+        size_t chunk_count;
+        size_t reserved_bytes; // capacity of every chunk, cached ones included
+    };
+
     struct Allocator {
-        void* memory; // pointer to the start of our memory block
-        size_t capacity; // total size
-        size_t offset; // current position
+        void* memory; // pointer to the start of the current chunk's memory
+        size_t capacity; // size of the current chunk
+        size_t offset; // current position in the current chunk
+        Options options;
+        Chunk* first;
+        Chunk* current;
+        size_t used_before; // bytes used in the chunks before current
+#ifdef ALLOC_STATS
+        Counters counters;
+#endif
+    };
+
+    // a position in the arena to roll back to
+    struct Marker {
+        Chunk* chunk;
+        size_t offset;
+        size_t used_before;
     };
-    bool init(Allocator& allocator, size_t total_size);
+    bool init(Allocator& allocator, size_t total_size, const Options& options = Options());
 
     void* alloc(Allocator& allocator, size_t size, size_t alignment);
 
+    // pops ptr if it is the most recent allocation in the current chunk, otherwise does nothing
+    // (the memory comes back with the next rollbackTo or reset). needs Options::headers,
+    // without them it never pops anything
     void free(Allocator& allocator, void* ptr);
 
     void destroy(Allocator& allocator);
 
+    // rewinds to the first chunk, later chunks are kept for reuse
     void reset(Allocator& allocator);
 
     size_t getUsed(const Allocator& allocator);
 
     size_t getAvailable(const Allocator& allocator);
+
+    Stats getStats(const Allocator& allocator);
+
+    // decommits the pages past the current offset, in the current chunk and every cached one,
+    // e.g. right after a reset that followed a load spike. only mmap backed arenas are trimmed.
+    // returns the bytes decommitted
+    size_t trim(Allocator& allocator);
+
+    // true when ptr lies in one of the arena's chunks
+    bool owns(const Allocator& allocator, const void* ptr);
+
+    Marker getMarker(const Allocator& allocator);
+
+    // releases everything allocated since marker was taken, chunks past it stay cached
+    void rollbackTo(Allocator& allocator, const Marker& marker);
+
+    // one fixed region bumped from both ends: the low end grows up (long-lived results), the high
+    // end grows down (scratch), they fail once they would meet. each end has its own reset and
+    // markers, so scratch can be dropped without touching what the low end holds
+    enum class End { Low, High };
+
+    struct DoubleEnded {
+        void* memory;
+        size_t capacity;
+        size_t low;  // first free byte of the low end
+        size_t high; // first byte in use by the high end, capacity when it is empty
+    };
+
+    bool init(DoubleEnded& allocator, size_t total_size);
+
+    void* alloc(DoubleEnded& allocator, size_t size, size_t alignment, End end = End::Low);
+
+    // does nothing, memory comes back with reset or rollbackTo of its end
+    void free(DoubleEnded& allocator, void* ptr);
+
+    void reset(DoubleEnded& allocator, End end);
+
+    // both ends at once
+    void reset(DoubleEnded& allocator);
+
+    // a marker is the offset of that end
+    size_t getMarker(const DoubleEnded& allocator, End end);
+
+    // releases everything end allocated since marker was taken
+    void rollbackTo(DoubleEnded& allocator, End end, size_t marker);
+
+    size_t getUsed(const DoubleEnded& allocator, End end);
+
+    // the gap between the two ends, shared by both
+    size_t getAvailable(const DoubleEnded& allocator);
+
+    bool owns(const DoubleEnded& allocator, const void* ptr);
+
+    void destroy(DoubleEnded& allocator);
+
+    // rolls the arena back to where it was when the scope started
+    class ScopedArena {
+        public:
+            explicit ScopedArena(Allocator& allocator) : allocator(allocator), marker(getMarker(allocator)) {}
+            ~ScopedArena() { rollbackTo(allocator, marker); }
+
+            ScopedArena(const ScopedArena&) = delete;
+            ScopedArena& operator=(const ScopedArena&) = delete;
+
+        private:
+            Allocator& allocator;
+            Marker marker;
+    };
+
+    // rolls one end of a DoubleEnded back to where it was when the scope started
+    class ScopedEnd {
+        public:
+            ScopedEnd(DoubleEnded& allocator, End end) : allocator(allocator), end(end), marker(getMarker(allocator, end)) {}
+            ~ScopedEnd() { rollbackTo(allocator, end, marker); }
+
+            ScopedEnd(const ScopedEnd&) = delete;
+            ScopedEnd& operator=(const ScopedEnd&) = delete;
+
+        private:
+            DoubleEnded& allocator;
+            End end;
+            size_t marker;
+    };
 }
@@ -0,0 +1,269 @@
+#include "FreeListAllocator.h"
+#include "types.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// malloc replacement for LD_PRELOAD, built into libcustomalloc.so by `make shared`:
+//
+//   LD_PRELOAD=./libcustomalloc.so ./some_binary
+//
+// the heap is one growable FreeList arena. it starts in a static buffer, so the very first
+// allocations (made by the loader and libc before main) need no syscall, and maps regions of up
+// to REGION_SIZE on demand. requests of HUGE_SIZE and up get their own mapping.
+// nothing here calls into the system malloc or dlsym, so there is no bootstrap recursion to
+// break: the arena is built with FreeList::init over external memory and grows with mmap, neither
+// allocates. one spinlock guards everything (a pthread mutex may allocate on first use)
+
+namespace {
+
+const size_t BOOTSTRAP_SIZE = 1024 * 1024;
+const size_t REGION_SIZE = 64 * 1024 * 1024; // address space is reserved, pages commit when touched
+const size_t HUGE_SIZE = 1024 * 1024;
+const size_t MALLOC_ALIGNMENT = alignof(std::max_align_t);
+
+// sits right before every huge pointer
+struct HugeHeader {
+    size_t mapping_size;
+    size_t offset; // from the start of the mapping to the user pointer
+    size_t magic;  // HUGE_MAGIC, anything else was never ours
+};
+
+const size_t HUGE_MAGIC = 0x6875676568656164; // "hugehead"
+
+alignas(64) uint8_t bootstrap_memory[BOOTSTRAP_SIZE];
+FreeList::Allocator heap;
+bool heap_ready = false;
+std::atomic_flag lock = ATOMIC_FLAG_INIT;
+std::atomic<bool> fork_handlers_registered{false};
+
+void acquire() {
+    while (lock.test_and_set(std::memory_order_acquire)) sched_yield();
+}
+
+void release() {
+    lock.clear(std::memory_order_release);
+}
+
+// keep the lock consistent across fork, the child gets a copy of whatever the parent held
+void register_fork_handlers() {
+    if (fork_handlers_registered.exchange(true)) return;
+    pthread_atfork(acquire, release, release);
+}
+
+size_t page_size() {
+    static size_t size = (size_t) sysconf(_SC_PAGESIZE);
+    return size;
+}
+
+size_t round_up(size_t value, size_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// lock must be held
+void init_heap() {
+    if (heap_ready) return;
+    FreeList::Options options;
+    options.policy = FreeList::FitPolicy::Segregated;
+    options.zeroed_memory = true; // .bss
+    options.growable = true;
+    options.mmap_backed = true; // only the regions, the buffer stays ours
+    options.max_region_size = REGION_SIZE;
+    FreeList::init(heap, bootstrap_memory, BOOTSTRAP_SIZE, options);
+    heap_ready = true;
+}
+
+// lock must be held, huge blocks are the only other pointers free sees.
+// O(1) for the bootstrap buffer, a binary search over the mapped regions otherwise
+bool in_heap(void* ptr) {
+    return heap_ready && FreeList::owns(heap, ptr);
+}
+
+void* alloc_huge(size_t size, size_t alignment) {
+    size_t offset = round_up(sizeof(HugeHeader), alignment);
+    if (size > SIZE_MAX - offset - page_size()) return nullptr;
+
+    // mmap only promises page alignment, over-map for anything stricter
+    size_t slack = alignment > page_size() ? alignment : 0;
+    size_t mapping_size = round_up(offset + size + slack, page_size());
+    void* mapping = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) return nullptr;
+
+    uint8_t* ptr = (uint8_t*) round_up((uintptr_t) mapping + sizeof(HugeHeader), alignment);
+    HugeHeader* header = (HugeHeader*) ptr - 1;
+    header->mapping_size = mapping_size;
+    header->offset = ptr - (uint8_t*) mapping;
+    header->magic = HUGE_MAGIC;
+    return ptr;
+}
+
+// the header of a pointer that is not in the heap. anything without the magic word was not
+// handed out by us (a wild pointer, one from another allocator): abort like glibc does rather
+// than unmap whatever its garbage header points at
+HugeHeader* huge_header(void* ptr) {
+    HugeHeader* header = (HugeHeader*) ptr - 1;
+    if (header->magic != HUGE_MAGIC) {
+        const char message[] = "customalloc: invalid pointer\n";
+        ssize_t written = write(STDERR_FILENO, message, sizeof(message) - 1);
+        (void) written;
+        abort();
+    }
+    return header;
+}
+
+void free_huge(void* ptr) {
+    HugeHeader* header = huge_header(ptr);
+    munmap((uint8_t*) ptr - header->offset, header->mapping_size);
+}
+
+size_t huge_usable_size(void* ptr) {
+    HugeHeader* header = huge_header(ptr);
+    return header->mapping_size - header->offset;
+}
+
+// with zero the memory comes back cleared, fresh mappings already are
+void* allocate(size_t size, size_t alignment, bool zero = false) {
+    alignment = std::max(alignment, MALLOC_ALIGNMENT);
+    if (size >= HUGE_SIZE || alignment >= HUGE_SIZE) return alloc_huge(size, alignment);
+
+    acquire();
+    init_heap();
+    void* ptr = zero ? FreeList::calloc(heap, 1, size, alignment) : FreeList::alloc(heap, size, alignment);
+    release();
+    register_fork_handlers();
+    return ptr;
+}
+
+void deallocate(void* ptr) {
+    if (ptr == nullptr) return;
+
+    acquire();
+    bool ours = in_heap(ptr);
+    if (ours) FreeList::free(heap, ptr);
+    release();
+
+    if (!ours) free_huge(ptr);
+}
+
+size_t usable_size(void* ptr) {
+    if (ptr == nullptr) return 0;
+
+    acquire();
+    bool ours = in_heap(ptr);
+    size_t size = ours ? FreeList::usableSize(heap, ptr) : 0;
+    release();
+
+    return ours ? size : huge_usable_size(ptr);
+}
+
+// grows in place when the arena can, otherwise moves. FreeList::realloc is not used for the move
+// because it only guarantees MIN_ALIGNMENT, malloc has to hand out MALLOC_ALIGNMENT
+void* reallocate(void* ptr, size_t new_size) {
+    size_t old_size = usable_size(ptr);
+    if (new_size <= old_size) return ptr;
+
+    acquire();
+    bool grown = in_heap(ptr) && new_size < HUGE_SIZE && FreeList::try_expand(heap, ptr, new_size);
+    release();
+    if (grown) return ptr;
+
+    void* new_ptr = allocate(new_size, MALLOC_ALIGNMENT);
+    if (new_ptr == nullptr) return nullptr;
+    std::memcpy(new_ptr, ptr, old_size);
+    deallocate(ptr);
+    return new_ptr;
+}
+
+bool valid_alignment(size_t alignment) {
+    return alignment != 0 && (alignment & (alignment - 1)) == 0;
+}
+
+}
+
+extern "C" {
+
+void* malloc(size_t size) noexcept {
+    void* ptr = allocate(size, MALLOC_ALIGNMENT);
+    if (ptr == nullptr) errno = ENOMEM;
+    return ptr;
+}
+
+void free(void* ptr) noexcept {
+    deallocate(ptr);
+}
+
+void* calloc(size_t count, size_t size) noexcept {
+    size_t total;
+    if (__builtin_mul_overflow(count, size, &total)) {
+        errno = ENOMEM;
+        return nullptr;
+    }
+
+    void* ptr = allocate(total, MALLOC_ALIGNMENT, true);
+    if (ptr == nullptr) errno = ENOMEM;
+    return ptr;
+}
+
+void* realloc(void* ptr, size_t new_size) noexcept {
+    if (ptr == nullptr) return malloc(new_size);
+    if (new_size == 0) {
+        deallocate(ptr);
+        return nullptr;
+    }
+
+    void* new_ptr = reallocate(ptr, new_size);
+    if (new_ptr == nullptr) errno = ENOMEM;
+    return new_ptr;
+}
+
+int posix_memalign(void** out, size_t alignment, size_t size) noexcept {
+    if (!valid_alignment(alignment) || alignment % sizeof(void*) != 0) return EINVAL;
+
+    void* ptr = allocate(size, alignment);
+    if (ptr == nullptr) return ENOMEM;
+    *out = ptr;
+    return 0;
+}
+
+void* aligned_alloc(size_t alignment, size_t size) noexcept {
+    if (!valid_alignment(alignment)) {
+        errno = EINVAL;
+        return nullptr;
+    }
+
+    void* ptr = allocate(size, alignment);
+    if (ptr == nullptr) errno = ENOMEM;
+    return ptr;
+}
+
+// legacy entry points, pointers from them reach our free so they have to come from us too
+void* memalign(size_t alignment, size_t size) noexcept {
+    return aligned_alloc(alignment, size);
+}
+
+void* valloc(size_t size) noexcept {
+    return aligned_alloc(page_size(), size);
+}
+
+// valloc with the size rounded up to whole pages, at least one
+void* pvalloc(size_t size) noexcept {
+    if (size > SIZE_MAX - page_size()) {
+        errno = ENOMEM;
+        return nullptr;
+    }
+    return aligned_alloc(page_size(), round_up(std::max(size, (size_t) 1), page_size()));
+}
+
+size_t malloc_usable_size(void* ptr) noexcept {
+    return usable_size(ptr);
+}
+
+}
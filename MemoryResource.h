@@ -0,0 +1,194 @@
+#pragma once
+
+#include "ConcurrentFreeListAllocator.h"
+#include "FreeListAllocator.h"
+#include "LinearAllocator.h"
+#include "PoolAllocator.h"
+#include "TLSFAllocator.h"
+#include <cstddef>
+#include <cstdint>
+
+#include <memory_resource>
+#include <new>
+
+// std::pmr::memory_resource views of the allocators, so std::pmr containers can use any of
+// them through one container type and switch between them at runtime. the resource does not
+// own the allocator, it only forwards to it.
+//
+// the arena backed resources take an optional upstream: requests the arena cannot serve go there
+// instead of throwing, and deallocate sends anything outside the arena back to it
+namespace MemoryResource {
+
+namespace detail {
+    inline void* or_upstream(void* ptr, std::pmr::memory_resource* upstream, size_t bytes, size_t alignment) {
+        if (ptr != nullptr) return ptr;
+        if (upstream == nullptr) throw std::bad_alloc();
+        return upstream->allocate(bytes, alignment);
+    }
+
+    inline bool in_range(const void* memory, size_t capacity, const void* ptr) {
+        return (const uint8_t*) memory <= (const uint8_t*) ptr && (const uint8_t*) ptr < (const uint8_t*) memory + capacity;
+    }
+}
+
+class FreeListResource : public std::pmr::memory_resource {
+    public:
+        explicit FreeListResource(FreeList::Allocator& allocator, std::pmr::memory_resource* upstream = nullptr)
+            : allocator(allocator), upstream(upstream) {}
+
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override {
+            return detail::or_upstream(FreeList::alloc_sized(allocator, bytes, alignment), upstream, bytes, alignment);
+        }
+
+        void do_deallocate(void* ptr, size_t bytes, size_t alignment) override {
+            if (FreeList::owns(allocator, ptr)) {
+                FreeList::free_sized(allocator, ptr, bytes, alignment);
+            } else if (upstream != nullptr) {
+                upstream->deallocate(ptr, bytes, alignment);
+            }
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+
+        FreeList::Allocator& allocator;
+        std::pmr::memory_resource* upstream;
+};
+
+class TLSFResource : public std::pmr::memory_resource {
+    public:
+        explicit TLSFResource(TLSF::Allocator& allocator, std::pmr::memory_resource* upstream = nullptr)
+            : allocator(allocator), upstream(upstream) {}
+
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override {
+            return detail::or_upstream(TLSF::alloc(allocator, bytes, alignment), upstream, bytes, alignment);
+        }
+
+        void do_deallocate(void* ptr, size_t bytes, size_t alignment) override {
+            if (detail::in_range(allocator.memory, allocator.capacity, ptr)) {
+                TLSF::free(allocator, ptr);
+            } else if (upstream != nullptr) {
+                upstream->deallocate(ptr, bytes, alignment);
+            }
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+
+        TLSF::Allocator& allocator;
+        std::pmr::memory_resource* upstream;
+};
+
+// deallocate only gives memory back when it was the last allocation and the arena keeps
+// headers (Linear::Options::headers), everything else is released by reset or rollbackTo.
+// this is the fast arena to put in front of a general purpose upstream
+class LinearResource : public std::pmr::memory_resource {
+    public:
+        explicit LinearResource(Linear::Allocator& allocator, std::pmr::memory_resource* upstream = nullptr)
+            : allocator(allocator), upstream(upstream) {}
+
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override {
+            return detail::or_upstream(Linear::alloc(allocator, bytes, alignment), upstream, bytes, alignment);
+        }
+
+        void do_deallocate(void* ptr, size_t bytes, size_t alignment) override {
+            if (Linear::owns(allocator, ptr)) {
+                Linear::free(allocator, ptr);
+            } else if (upstream != nullptr) {
+                upstream->deallocate(ptr, bytes, alignment);
+            }
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+
+        Linear::Allocator& allocator;
+        std::pmr::memory_resource* upstream;
+};
+
+// one slot size, anything bigger or more aligned than a slot goes upstream (or throws)
+class PoolResource : public std::pmr::memory_resource {
+    public:
+        explicit PoolResource(Pool::Allocator& allocator, std::pmr::memory_resource* upstream = nullptr)
+            : allocator(allocator), upstream(upstream) {}
+
+    private:
+        bool pooled(size_t bytes, size_t alignment) const {
+            return bytes <= allocator.slot_size && alignment <= allocator.alignment;
+        }
+
+        void* do_allocate(size_t bytes, size_t alignment) override {
+            void* ptr = pooled(bytes, alignment) ? Pool::alloc(allocator) : nullptr;
+            return detail::or_upstream(ptr, upstream, bytes, alignment);
+        }
+
+        // slots and upstream blocks are told apart by size, like PoolSet does
+        void do_deallocate(void* ptr, size_t bytes, size_t alignment) override {
+            if (pooled(bytes, alignment)) {
+                Pool::free(allocator, ptr);
+            } else if (upstream != nullptr) {
+                upstream->deallocate(ptr, bytes, alignment);
+            }
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+
+        Pool::Allocator& allocator;
+        std::pmr::memory_resource* upstream;
+};
+
+// pmr hands the size back on deallocate, which is exactly what PoolSet::free needs
+class PoolSetResource : public std::pmr::memory_resource {
+    public:
+        explicit PoolSetResource(PoolSet::Allocator& allocator) : allocator(allocator) {}
+
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override {
+            void* ptr = PoolSet::alloc(allocator, bytes, alignment);
+            if (ptr == nullptr) throw std::bad_alloc();
+            return ptr;
+        }
+
+        void do_deallocate(void* ptr, size_t bytes, size_t alignment) override {
+            PoolSet::free(allocator, ptr, bytes, alignment);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+
+        PoolSet::Allocator& allocator;
+};
+
+// safe to share between threads, like the allocator behind it
+class ConcurrentFreeListResource : public std::pmr::memory_resource {
+    public:
+        explicit ConcurrentFreeListResource(ConcurrentFreeList::Allocator& allocator) : allocator(allocator) {}
+
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override {
+            void* ptr = ConcurrentFreeList::alloc(allocator, bytes, alignment);
+            if (ptr == nullptr) throw std::bad_alloc();
+            return ptr;
+        }
+
+        void do_deallocate(void* ptr, size_t, size_t) override {
+            ConcurrentFreeList::free(allocator, ptr);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+
+        ConcurrentFreeList::Allocator& allocator;
+};
+
+}
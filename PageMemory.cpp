@@ -0,0 +1,109 @@
+#include "PageMemory.h"
+#include <cstdlib>
+#include <initializer_list>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace Pages {
+
+namespace {
+
+uintptr_t round_up(uintptr_t value, size_t alignment) {
+    return (value + alignment - 1) & ~(uintptr_t)(alignment - 1);
+}
+
+uintptr_t round_down(uintptr_t value, size_t alignment) {
+    return value & ~(uintptr_t)(alignment - 1);
+}
+
+// MAP_NORESERVE: nothing is charged against overcommit until a page is touched. not for
+// MAP_HUGETLB, there it would let the mapping succeed on an empty pool and SIGBUS on first touch
+void* map(size_t size, int extra_flags) {
+    int reserve_flag = (extra_flags & MAP_HUGETLB) ? 0 : MAP_NORESERVE;
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | reserve_flag | extra_flags, -1, 0);
+    return memory == MAP_FAILED ? nullptr : memory;
+}
+
+// fresh zero pages over [memory, memory + size), replacing whatever is (or is not) mapped there
+bool map_fixed(void* memory, size_t size) {
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED;
+    return mmap(memory, size, PROT_READ | PROT_WRITE, flags, -1, 0) != MAP_FAILED;
+}
+
+// transparent huge pages only back 2 MiB aligned ranges, so over-map and cut the ends off
+void* map_huge_aligned(size_t size) {
+    uint8_t* raw = (uint8_t*) map(size + HUGE_PAGE_SIZE, 0);
+    if (raw == nullptr) return nullptr;
+
+    uint8_t* aligned = (uint8_t*) round_up((uintptr_t) raw, HUGE_PAGE_SIZE);
+    if (aligned != raw) munmap(raw, aligned - raw);
+    size_t tail = (raw + size + HUGE_PAGE_SIZE) - (aligned + size);
+    if (tail != 0) munmap(aligned + size, tail);
+
+    madvise(aligned, size, MADV_HUGEPAGE); // only a hint, fine if THP is off
+    return aligned;
+}
+
+}
+
+size_t page_size() {
+    static const size_t size = (size_t) sysconf(_SC_PAGESIZE);
+    return size;
+}
+
+void* reserve(size_t& size, HugePages huge_pages) {
+    if (huge_pages == HugePages::Off) {
+        size = round_up(size, page_size());
+        return map(size, 0);
+    }
+
+    size = round_up(size, HUGE_PAGE_SIZE);
+    if (huge_pages == HugePages::Explicit) {
+        void* memory = map(size, MAP_HUGETLB);
+        if (memory != nullptr) return memory;
+    }
+    return map_huge_aligned(size);
+}
+
+void release(void* memory, size_t size) {
+    if (memory != nullptr) munmap(memory, size);
+}
+
+size_t decommit(void* memory, size_t size) {
+    // MAP_HUGETLB mappings only take whole huge pages, retry at that granularity
+    for (size_t granularity : {page_size(), HUGE_PAGE_SIZE}) {
+        uintptr_t start = round_up((uintptr_t) memory, granularity);
+        uintptr_t end = round_down((uintptr_t) memory + size, granularity);
+        if (end <= start) return 0;
+
+        if (madvise((void*) start, end - start, MADV_DONTNEED) == 0) return end - start;
+    }
+    return 0;
+}
+
+bool remap(void* from, void* to, size_t size) {
+    // the move leaves a hole at from, the pages that fill it are mapped up front
+    void* fresh = map(size, 0);
+    if (fresh == nullptr) return false;
+
+    if (mremap(from, size, size, MREMAP_MAYMOVE | MREMAP_FIXED, to) == MAP_FAILED) {
+        munmap(fresh, size);
+        return false;
+    }
+    if (mremap(fresh, size, size, MREMAP_MAYMOVE | MREMAP_FIXED, from) != MAP_FAILED) return true;
+
+    // moving them in can still fail, e.g. with ENOMEM once vm.max_map_count is reached (every
+    // move splits the arena's mapping). the data already sits at to, so a plain mapping over
+    // the hole finishes the move just as well
+    munmap(fresh, size);
+    if (map_fixed(from, size)) return true;
+
+    // no new mapping at all: move the data back, the hole is at to now and has to be filled
+    // the same way. if even that fails the arena has a hole nothing can repair
+    if (mremap(to, size, size, MREMAP_MAYMOVE | MREMAP_FIXED, from) == MAP_FAILED || !map_fixed(to, size)) {
+        std::abort();
+    }
+    return false;
+}
+
+}
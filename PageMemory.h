@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <stdint.h>
+
+// arenas straight from the kernel instead of malloc. address space is reserved up front and
+// pages are only committed when first touched, so a big arena costs nothing until it is used.
+// decommit hands whole pages back, they read as zero the next time they are touched
+namespace Pages {
+
+enum class HugePages {
+    Off,
+    Transparent, // 2 MiB aligned mapping + madvise(MADV_HUGEPAGE), the kernel promotes pages when it can
+    Explicit,    // MAP_HUGETLB from the reserved huge page pool, falls back to Transparent when the pool is empty
+};
+
+const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+size_t page_size();
+
+// maps at least size bytes, size is updated to what was really mapped (whole pages).
+// returns nullptr when the mapping fails
+void* reserve(size_t& size, HugePages huge_pages = HugePages::Off);
+
+// unmaps memory from reserve, size is the updated size reserve returned
+void release(void* memory, size_t size);
+
+// gives the whole pages inside [memory, memory + size) back to the OS, the bytes around them
+// are left alone. returns how many bytes were decommitted
+size_t decommit(void* memory, size_t size);
+
+// moves the pages of [from, from + size) to [to, to + size) without copying them (mremap), from
+// reads as zero afterwards. both ranges must be page aligned, inside mappings from reserve and
+// not overlap. returns false when the kernel refuses (e.g. MAP_HUGETLB) or the mapping cannot be
+// patched up after the move, from still holds the data then (to may read as zero)
+bool remap(void* from, void* to, size_t size);
+
+}
@@ -0,0 +1,231 @@
+#include "PoolAllocator.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
+namespace Pool {
+    namespace {
+        uintptr_t align_forward(uintptr_t addr, size_t alignment) {
+            return (addr + alignment - 1) & ~(alignment - 1);
+        }
+
+        // threads whatever is left of the current chunk onto the free list
+        void retire_chunk(Allocator& allocator) {
+            while (allocator.cursor != nullptr && allocator.cursor + allocator.slot_size <= allocator.end) {
+                Slot* slot = (Slot*) allocator.cursor;
+                slot->next = allocator.free_list;
+                allocator.free_list = slot;
+                allocator.cursor += allocator.slot_size;
+            }
+            allocator.cursor = nullptr;
+            allocator.end = nullptr;
+        }
+    }
+
+    bool init(Allocator& allocator, size_t slot_size, size_t slot_count, size_t alignment) {
+        assert((alignment != 0) && ((alignment & (alignment - 1)) == 0) && "alignment must be a power of 2");
+
+        alignment = std::max(alignment, alignof(Slot));
+        // every slot must hold the free list link and keep the next slot aligned
+        allocator.slot_size = align_forward(std::max(slot_size, sizeof(Slot)), alignment);
+        allocator.alignment = alignment;
+        allocator.free_list = nullptr;
+        allocator.cursor = nullptr;
+        allocator.end = nullptr;
+        allocator.used = 0;
+        allocator.slot_count = 0;
+        allocator.memory = nullptr;
+        allocator.capacity = 0;
+
+        if (slot_count == 0) return true;
+
+        size_t total_size = allocator.slot_size * slot_count + alignment - 1;
+        allocator.memory = std::malloc(total_size);
+        if (allocator.memory == nullptr) {
+            return false;
+        }
+        allocator.capacity = total_size;
+
+        refill(allocator, allocator.memory, total_size);
+        return true;
+    }
+
+    void* alloc(Allocator& allocator) {
+        Slot* slot = allocator.free_list;
+        if (slot != nullptr) {
+            allocator.free_list = slot->next;
+        } else if (allocator.cursor != nullptr && allocator.cursor + allocator.slot_size <= allocator.end) {
+            slot = (Slot*) allocator.cursor;
+            allocator.cursor += allocator.slot_size;
+        } else {
+            return nullptr;
+        }
+
+        allocator.used++;
+        return slot;
+    }
+
+    void free(Allocator& allocator, void* ptr) {
+        if (ptr == nullptr) return;
+        assert(allocator.used > 0 && "more frees than allocations");
+
+        Slot* slot = (Slot*) ptr;
+        slot->next = allocator.free_list;
+        allocator.free_list = slot;
+        allocator.used--;
+    }
+
+    size_t alloc_batch(Allocator& allocator, void** out, size_t n) {
+        size_t count = 0;
+
+        // recycled slots first
+        Slot* slot = allocator.free_list;
+        while (count < n && slot != nullptr) {
+            out[count++] = slot;
+            slot = slot->next;
+        }
+        allocator.free_list = slot;
+
+        // then a run of fresh ones from the chunk
+        if (count < n && allocator.cursor != nullptr) {
+            size_t fresh = (allocator.end - allocator.cursor) / allocator.slot_size;
+            fresh = std::min(fresh, n - count);
+            for (size_t i = 0; i < fresh; i++) {
+                out[count++] = allocator.cursor;
+                allocator.cursor += allocator.slot_size;
+            }
+        }
+
+        allocator.used += count;
+        return count;
+    }
+
+    void free_batch(Allocator& allocator, void** ptrs, size_t n) {
+        // link the batch up first, then splice it in with one head update
+        Slot* head = allocator.free_list;
+        size_t count = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (ptrs[i] == nullptr) continue;
+            Slot* slot = (Slot*) ptrs[i];
+            slot->next = head;
+            head = slot;
+            count++;
+        }
+        assert(allocator.used >= count && "more frees than allocations");
+
+        allocator.free_list = head;
+        allocator.used -= count;
+    }
+
+    size_t refill(Allocator& allocator, void* memory, size_t size) {
+        uintptr_t start = align_forward((uintptr_t) memory, allocator.alignment);
+        uintptr_t end = (uintptr_t) memory + size;
+        if (start >= end) return 0;
+
+        size_t slots = (end - start) / allocator.slot_size;
+        if (slots == 0) return 0;
+
+        retire_chunk(allocator);
+        allocator.cursor = (uint8_t*) start;
+        allocator.end = (uint8_t*) start + slots * allocator.slot_size;
+        allocator.slot_count += slots;
+
+        return slots;
+    }
+
+    void destroy(Allocator& allocator) {
+        if (allocator.memory) {
+            std::free(allocator.memory);
+            allocator.memory = nullptr;
+        }
+        allocator.capacity = 0;
+        allocator.free_list = nullptr;
+        allocator.cursor = nullptr;
+        allocator.end = nullptr;
+        allocator.used = 0;
+        allocator.slot_count = 0;
+    }
+
+    size_t getUsed(const Allocator& allocator) {
+        return allocator.used;
+    }
+
+    size_t getAvailable(const Allocator& allocator) {
+        return allocator.slot_count - allocator.used;
+    }
+}
+
+namespace PoolSet {
+    namespace {
+        bool pooled(size_t size, size_t alignment) {
+            return size <= MAX_POOLED_SIZE && alignment <= MIN_ALIGNMENT;
+        }
+
+        size_t pool_index(size_t size) {
+            return (std::max(size, (size_t)1) + MIN_ALIGNMENT - 1) / MIN_ALIGNMENT - 1;
+        }
+
+        // pulls one more chunk from upstream into the pool
+        bool grow(Allocator& allocator, Pool::Allocator& pool) {
+            void* chunk = FreeList::alloc(*allocator.upstream, allocator.chunk_size, MIN_ALIGNMENT);
+            if (chunk == nullptr) return false;
+
+            // first word links the chunk for destroy, slots start after it
+            *(void**) chunk = allocator.chunks;
+            allocator.chunks = chunk;
+
+            Pool::refill(pool, (uint8_t*) chunk + sizeof(void*), allocator.chunk_size - sizeof(void*));
+            return true;
+        }
+    }
+
+    bool init(Allocator& allocator, FreeList::Allocator& upstream, size_t chunk_size) {
+        allocator.upstream = &upstream;
+        allocator.chunks = nullptr;
+        // a chunk must at least hold its link and one slot of the biggest size
+        allocator.chunk_size = std::max(chunk_size, sizeof(void*) + MAX_POOLED_SIZE);
+
+        for (size_t i = 0; i < POOL_COUNT; i++) {
+            if (!Pool::init(allocator.pools[i], (i + 1) * MIN_ALIGNMENT, 0)) return false;
+        }
+        return true;
+    }
+
+    void* alloc(Allocator& allocator, size_t size, size_t alignment) {
+        if (!pooled(size, alignment)) {
+            return FreeList::alloc(*allocator.upstream, size, alignment);
+        }
+
+        Pool::Allocator& pool = allocator.pools[pool_index(size)];
+        void* ptr = Pool::alloc(pool);
+        if (ptr == nullptr && grow(allocator, pool)) {
+            ptr = Pool::alloc(pool);
+        }
+        return ptr;
+    }
+
+    void free(Allocator& allocator, void* ptr, size_t size, size_t alignment) {
+        if (ptr == nullptr) return;
+
+        if (!pooled(size, alignment)) {
+            FreeList::free(*allocator.upstream, ptr);
+            return;
+        }
+
+        Pool::free(allocator.pools[pool_index(size)], ptr);
+    }
+
+    void destroy(Allocator& allocator) {
+        void* chunk = allocator.chunks;
+        while (chunk != nullptr) {
+            void* next = *(void**) chunk;
+            FreeList::free(*allocator.upstream, chunk);
+            chunk = next;
+        }
+        allocator.chunks = nullptr;
+
+        for (size_t i = 0; i < POOL_COUNT; i++) {
+            Pool::destroy(allocator.pools[i]);
+        }
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <stdint.h>
+
+#include "FreeListAllocator.h"
+#include "types.h"
+
+// fixed size slots, no per-object header. free slots are kept on an intrusive LIFO list,
+// untouched memory is carved lazily from the current chunk, so alloc and free are O(1)
+namespace Pool {
+    struct Slot {
+        Slot* next;
+    };
+
+    struct Allocator {
+        void* memory; // chunk owned by the pool (from init), nullptr if it only uses refilled memory
+        size_t capacity;
+        size_t slot_size;
+        size_t alignment;
+        Slot* free_list;
+        uint8_t* cursor; // next never-used slot in the current chunk
+        uint8_t* end;    // end of the current chunk
+        size_t used;     // slots handed out
+        size_t slot_count; // slots across all chunks
+    };
+
+    // slot_count may be 0, the pool then only serves memory given to it through refill
+    bool init(Allocator& allocator, size_t slot_size, size_t slot_count, size_t alignment = MIN_ALIGNMENT);
+
+    void* alloc(Allocator& allocator);
+
+    void free(Allocator& allocator, void* ptr);
+
+    // pops up to n slots into out, returns how many it got
+    size_t alloc_batch(Allocator& allocator, void** out, size_t n);
+
+    void free_batch(Allocator& allocator, void** ptrs, size_t n);
+
+    // adds size bytes at memory as a new chunk of slots, the pool does not take ownership.
+    // returns the number of slots added
+    size_t refill(Allocator& allocator, void* memory, size_t size);
+
+    void destroy(Allocator& allocator);
+
+    size_t getUsed(const Allocator& allocator);
+
+    size_t getAvailable(const Allocator& allocator);
+}
+
+// one pool per slot size (in MIN_ALIGNMENT steps up to MAX_POOLED_SIZE), chunks are pulled from
+// a FreeList whenever a pool runs dry. anything bigger or more aligned goes to the FreeList directly.
+// slots have no header, so free needs the size and alignment the block was allocated with
+namespace PoolSet {
+    const size_t MAX_POOLED_SIZE = 256;
+    const size_t POOL_COUNT = MAX_POOLED_SIZE / MIN_ALIGNMENT;
+
+    struct Allocator {
+        FreeList::Allocator* upstream;
+        size_t chunk_size; // bytes pulled from upstream per refill
+        void* chunks;      // every chunk pulled from upstream, linked through their first word
+        Pool::Allocator pools[POOL_COUNT]; // pools[i] serves (i + 1) * MIN_ALIGNMENT bytes
+    };
+
+    bool init(Allocator& allocator, FreeList::Allocator& upstream, size_t chunk_size = 4096);
+
+    void* alloc(Allocator& allocator, size_t size, size_t alignment);
+
+    void free(Allocator& allocator, void* ptr, size_t size, size_t alignment);
+
+    // gives every chunk back to upstream
+    void destroy(Allocator& allocator);
+}
@@ -1,13 +1,31 @@
 #pragma once
 
 #include "FreeListAllocator.h"
+#include "PoolAllocator.h"
+#include "TLSFAllocator.h"
 #include <cstddef>
 
 #include <limits>
 #include <new>
 #include <type_traits>
-
-template <typename T>
+#include <utility>
+
+// true when Backend has alloc_sized(backend, size, alignment) and free_sized(backend, ptr, size,
+// alignment) next to it
+template <typename Backend, typename = void>
+struct has_free_sized : std::false_type {};
+
+template <typename Backend>
+struct has_free_sized<Backend, std::void_t<
+    decltype(alloc_sized(std::declval<Backend&>(), size_t(), size_t())),
+    decltype(free_sized(std::declval<Backend&>(), (void*) nullptr, size_t(), size_t()))>>
+    : std::true_type {};
+
+// Backend is any allocator struct with alloc/free next to it in its namespace
+// (FreeList::Allocator, TLSF::Allocator), they are found through argument dependent lookup.
+// backends with the sized pair get every request through alloc_sized and the element count
+// back on deallocate, so FreeList with Options::size_classes serves small nodes header-less
+template <typename T, typename Backend = FreeList::Allocator>
 class STLAllocator {
     public:
         using value_type = T;
@@ -18,16 +36,16 @@ class STLAllocator {
         using is_always_equal = std::false_type;
 
         // a pointer to the custom allocator
-        FreeList::Allocator* allocator;
+        Backend* allocator;
 
         STLAllocator() : allocator(nullptr) {}
 
         // constructor
-        STLAllocator(FreeList::Allocator& allocator_ref) : allocator(&allocator_ref) {}
+        STLAllocator(Backend& allocator_ref) : allocator(&allocator_ref) {}
 
         // copy constructor
         template <typename U>
-        STLAllocator(const STLAllocator<U>& other) : allocator (other.allocator) {}
+        STLAllocator(const STLAllocator<U, Backend>& other) : allocator (other.allocator) {}
 
         // 1. allocate: translates "n" elements to bytes
         T* allocate (size_t n) {
@@ -37,7 +55,12 @@ class STLAllocator {
             if (allocator == nullptr)
                 throw std::bad_alloc();
 
-            void* ptr = FreeList::alloc(*allocator, n * sizeof(T), alignof(T));
+            void* ptr;
+            if constexpr (has_free_sized<Backend>::value) {
+                ptr = alloc_sized(*allocator, n * sizeof(T), alignof(T));
+            } else {
+                ptr = alloc(*allocator, n * sizeof(T), alignof(T));
+            }
 
             if (ptr == nullptr)
                 throw std::bad_alloc();
@@ -45,23 +68,82 @@ class STLAllocator {
             return static_cast<T*>(ptr);
         }
 
-        // deallocate
-        void deallocate(T* p, size_t) noexcept {
-            if (allocator)
-                FreeList::free(*allocator, p);
+        // deallocate, containers hand the count back so sized backends can skip the header lookup
+        void deallocate(T* p, size_t n) noexcept {
+            if (!allocator) return;
+
+            if constexpr (has_free_sized<Backend>::value) {
+                free_sized(*allocator, static_cast<void*>(p), n * sizeof(T), alignof(T));
+            } else {
+                free(*allocator, static_cast<void*>(p));
+            }
         }
 
         // equallity comparators (stateless allocators are always equal, but ours is stateful)
         // we say they are equal if they point to the same underlying allocator instance
         template <typename U>
-        bool operator==(const STLAllocator<U>& other) const {
+        bool operator==(const STLAllocator<U, Backend>& other) const {
             return allocator == other.allocator;
         }
 
         template <typename U>
-        bool operator!=(const STLAllocator<U>& other) const {
+        bool operator!=(const STLAllocator<U, Backend>& other) const {
             return !(*this == other);
         }
 
 
 };
+
+// node-based containers (map, set, list) rebind this to their node type, so every node
+// comes from a header-less pool slot of exactly its size. anything that is not a
+// single small node (vector storage, strings) falls through to the PoolSet's FreeList
+template <typename T>
+class PoolSTLAllocator {
+    public:
+        using value_type = T;
+
+        using propagate_on_container_copy_assignment = std::true_type;
+        using propagate_on_container_move_assignment = std::true_type;
+        using propagate_on_container_swap = std::true_type;
+        using is_always_equal = std::false_type;
+
+        PoolSet::Allocator* pools;
+
+        PoolSTLAllocator() : pools(nullptr) {}
+
+        PoolSTLAllocator(PoolSet::Allocator& pools_ref) : pools(&pools_ref) {}
+
+        template <typename U>
+        PoolSTLAllocator(const PoolSTLAllocator<U>& other) : pools(other.pools) {}
+
+        T* allocate(size_t n) {
+            if (n > std::numeric_limits<size_t>::max() / sizeof(T))
+                throw std::bad_alloc();
+
+            if (pools == nullptr)
+                throw std::bad_alloc();
+
+            void* ptr = PoolSet::alloc(*pools, n * sizeof(T), alignof(T));
+
+            if (ptr == nullptr)
+                throw std::bad_alloc();
+
+            return static_cast<T*>(ptr);
+        }
+
+        // slots have no header, the element count tells us which pool it came from
+        void deallocate(T* p, size_t n) noexcept {
+            if (pools)
+                PoolSet::free(*pools, p, n * sizeof(T), alignof(T));
+        }
+
+        template <typename U>
+        bool operator==(const PoolSTLAllocator<U>& other) const {
+            return pools == other.pools;
+        }
+
+        template <typename U>
+        bool operator!=(const PoolSTLAllocator<U>& other) const {
+            return !(*this == other);
+        }
+};
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+
+// std::malloc with the same free function surface as the allocators, so the benchmark and
+// replay tools (and STLAllocator) reach it through argument dependent lookup like everything else
+namespace SystemMalloc {
+    struct Allocator {};
+
+    inline void* alloc(Allocator&, size_t size, size_t alignment) {
+        if (alignment <= alignof(std::max_align_t)) return std::malloc(size);
+        return std::aligned_alloc(alignment, (size + alignment - 1) & ~(alignment - 1));
+    }
+
+    inline void free(Allocator&, void* ptr) {
+        std::free(ptr);
+    }
+
+    inline void* realloc(Allocator&, void* ptr, size_t new_size) {
+        return std::realloc(ptr, new_size);
+    }
+
+    inline void destroy(Allocator&) {}
+}
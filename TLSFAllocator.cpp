@@ -0,0 +1,436 @@
+/*
+** Two Level Segregated Fit memory allocator, after tlsf version 3.1
+** by Matthew Conte (https://github.com/mattconte/tlsf), ported to this
+** repository's C++ interface.
+**
+** Copyright (c) 2006-2016, Matthew Conte
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are met:
+**     * Redistributions of source code must retain the above copyright
+**       notice, this list of conditions and the following disclaimer.
+**     * Redistributions in binary form must reproduce the above copyright
+**       notice, this list of conditions and the following disclaimer in the
+**       documentation and/or other materials provided with the distribution.
+**     * Neither the name of the copyright holder nor the
+**       names of its contributors may be used to endorse or promote products
+**       derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+** WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+** DISCLAIMED. IN NO EVENT SHALL MATTHEW CONTE BE LIABLE FOR ANY
+** DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+** (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+** LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+** ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "TLSFAllocator.h"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+namespace TLSF {
+
+namespace {
+
+const size_t BLOCK_FREE = 1 << 0;
+const size_t BLOCK_PREV_FREE = 1 << 1;
+
+// only the size field is paid for by used blocks, prev_phys belongs to the previous block
+const size_t BLOCK_OVERHEAD = sizeof(size_t);
+const size_t BLOCK_START_OFFSET = offsetof(Block, size) + sizeof(size_t);
+const size_t BLOCK_SIZE_MIN = sizeof(Block) - sizeof(Block*);
+const size_t BLOCK_SIZE_MAX = (size_t)1 << FL_INDEX_MAX;
+
+// index of the highest set bit
+size_t fls(size_t value) {
+    return 63 - __builtin_clzll(value);
+}
+
+size_t block_size(const Block* block) {
+    return block->size & ~(BLOCK_FREE | BLOCK_PREV_FREE);
+}
+
+void set_size(Block* block, size_t size) {
+    block->size = size | (block->size & (BLOCK_FREE | BLOCK_PREV_FREE));
+}
+
+bool is_free(const Block* block) { return block->size & BLOCK_FREE; }
+bool is_prev_free(const Block* block) { return block->size & BLOCK_PREV_FREE; }
+
+void set_free(Block* block) { block->size |= BLOCK_FREE; }
+void set_used(Block* block) { block->size &= ~BLOCK_FREE; }
+void set_prev_free(Block* block) { block->size |= BLOCK_PREV_FREE; }
+void set_prev_used(Block* block) { block->size &= ~BLOCK_PREV_FREE; }
+
+void* to_ptr(Block* block) {
+    return (uint8_t*) block + BLOCK_START_OFFSET;
+}
+
+Block* from_ptr(void* ptr) {
+    return (Block*) ((uint8_t*) ptr - BLOCK_START_OFFSET);
+}
+
+Block* next_block(Block* block) {
+    return (Block*) ((uint8_t*) to_ptr(block) + block_size(block) - BLOCK_OVERHEAD);
+}
+
+// tells the physically next block where we are, returns it
+Block* link_next(Block* block) {
+    Block* next = next_block(block);
+    next->prev_phys = block;
+    return next;
+}
+
+void mark_as_free(Block* block) {
+    Block* next = link_next(block);
+    set_prev_free(next);
+    set_free(block);
+}
+
+void mark_as_used(Block* block) {
+    Block* next = next_block(block);
+    set_prev_used(next);
+    set_used(block);
+}
+
+size_t align_up(size_t value, size_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// rounds a request to something a block can hold, 0 when it can never be served
+size_t adjust_request_size(size_t size, size_t alignment) {
+    // checked before rounding, align_up would wrap a size near SIZE_MAX around to something small
+    if (size == 0 || size >= BLOCK_SIZE_MAX || alignment >= BLOCK_SIZE_MAX) return 0;
+    size_t aligned = align_up(size, alignment);
+    if (aligned >= BLOCK_SIZE_MAX) return 0;
+    return std::max(aligned, BLOCK_SIZE_MIN);
+}
+
+void mapping_insert(size_t size, size_t& fl, size_t& sl) {
+    if (size < SMALL_BLOCK_SIZE) {
+        fl = 0;
+        sl = size / (SMALL_BLOCK_SIZE / SL_INDEX_COUNT);
+    } else {
+        fl = fls(size);
+        sl = (size >> (fl - SL_INDEX_COUNT_LOG2)) ^ ((size_t)1 << SL_INDEX_COUNT_LOG2);
+        fl -= FL_INDEX_SHIFT - 1;
+    }
+}
+
+// like mapping_insert, but rounds up so every block in the resulting list is big enough
+void mapping_search(size_t size, size_t& fl, size_t& sl) {
+    if (size >= SMALL_BLOCK_SIZE) {
+        size_t round = ((size_t)1 << (fls(size) - SL_INDEX_COUNT_LOG2)) - 1;
+        size += round;
+    }
+    mapping_insert(size, fl, sl);
+}
+
+Block* search_suitable_block(Allocator& allocator, size_t& fl, size_t& sl) {
+    // rest of this first level first
+    uint32_t sl_map = allocator.sl_bitmap[fl] & (~(uint32_t)0 << sl);
+    if (sl_map == 0) {
+        // nothing left in this first level, move up to the next non-empty one
+        if (fl + 1 >= FL_INDEX_COUNT) return nullptr;
+        uint64_t fl_map = allocator.fl_bitmap & (~(uint64_t)0 << (fl + 1));
+        if (fl_map == 0) return nullptr;
+
+        fl = __builtin_ctzll(fl_map);
+        sl_map = allocator.sl_bitmap[fl];
+    }
+    sl = __builtin_ctz(sl_map);
+
+    return allocator.blocks[fl][sl];
+}
+
+void remove_free_block(Allocator& allocator, Block* block, size_t fl, size_t sl) {
+    Block* prev = block->prev_free;
+    Block* next = block->next_free;
+    if (next != nullptr) next->prev_free = prev;
+    if (prev != nullptr) prev->next_free = next;
+
+    if (allocator.blocks[fl][sl] == block) {
+        allocator.blocks[fl][sl] = next;
+        if (next == nullptr) {
+            allocator.sl_bitmap[fl] &= ~((uint32_t)1 << sl);
+            if (allocator.sl_bitmap[fl] == 0) {
+                allocator.fl_bitmap &= ~((uint64_t)1 << fl);
+            }
+        }
+    }
+}
+
+void insert_free_block(Allocator& allocator, Block* block, size_t fl, size_t sl) {
+    Block* current = allocator.blocks[fl][sl];
+    block->next_free = current;
+    block->prev_free = nullptr;
+    if (current != nullptr) current->prev_free = block;
+
+    allocator.blocks[fl][sl] = block;
+    allocator.fl_bitmap |= (uint64_t)1 << fl;
+    allocator.sl_bitmap[fl] |= (uint32_t)1 << sl;
+}
+
+void block_remove(Allocator& allocator, Block* block) {
+    size_t fl, sl;
+    mapping_insert(block_size(block), fl, sl);
+    remove_free_block(allocator, block, fl, sl);
+}
+
+void block_insert(Allocator& allocator, Block* block) {
+    size_t fl, sl;
+    mapping_insert(block_size(block), fl, sl);
+    insert_free_block(allocator, block, fl, sl);
+}
+
+bool block_can_split(Block* block, size_t size) {
+    return block_size(block) >= sizeof(Block) + size;
+}
+
+// splits block so it has exactly size bytes of payload, returns the tail
+Block* block_split(Block* block, size_t size) {
+    Block* remaining = (Block*) ((uint8_t*) to_ptr(block) + size - BLOCK_OVERHEAD);
+    size_t remaining_size = block_size(block) - (size + BLOCK_OVERHEAD);
+
+    remaining->size = 0;
+    set_size(remaining, remaining_size);
+    set_size(block, size);
+    mark_as_free(remaining);
+
+    return remaining;
+}
+
+// merges block into prev, both physically adjacent
+Block* block_absorb(Block* prev, Block* block) {
+    prev->size += block_size(block) + BLOCK_OVERHEAD;
+    link_next(prev);
+    return prev;
+}
+
+Block* merge_prev(Allocator& allocator, Block* block) {
+    if (is_prev_free(block)) {
+        Block* prev = block->prev_phys;
+        block_remove(allocator, prev);
+        block = block_absorb(prev, block);
+    }
+    return block;
+}
+
+Block* merge_next(Allocator& allocator, Block* block) {
+    Block* next = next_block(block);
+    if (is_free(next)) {
+        block_remove(allocator, next);
+        block = block_absorb(block, next);
+    }
+    return block;
+}
+
+// gives the tail of a free block back to the free structures
+void trim_free(Allocator& allocator, Block* block, size_t size) {
+    if (block_can_split(block, size)) {
+        Block* remaining = block_split(block, size);
+        link_next(block);
+        set_prev_free(remaining);
+        block_insert(allocator, remaining);
+    }
+}
+
+// gives the tail of a used block back to the free structures
+void trim_used(Allocator& allocator, Block* block, size_t size) {
+    if (block_can_split(block, size)) {
+        Block* remaining = block_split(block, size);
+        set_prev_used(remaining);
+        remaining = merge_next(allocator, remaining);
+        block_insert(allocator, remaining);
+    }
+}
+
+// gives the head of a free block back to the free structures, returns the rest
+Block* trim_free_leading(Allocator& allocator, Block* block, size_t size) {
+    Block* remaining = block;
+    if (block_can_split(block, size)) {
+        remaining = block_split(block, size - BLOCK_OVERHEAD);
+        set_prev_free(remaining);
+        link_next(block);
+        block_insert(allocator, block);
+    }
+    return remaining;
+}
+
+Block* locate_free(Allocator& allocator, size_t size) {
+    if (size == 0) return nullptr;
+
+    size_t fl, sl;
+    mapping_search(size, fl, sl);
+    if (fl >= FL_INDEX_COUNT) return nullptr;
+
+    Block* block = search_suitable_block(allocator, fl, sl);
+    if (block != nullptr) {
+        remove_free_block(allocator, block, fl, sl);
+    }
+    return block;
+}
+
+void* prepare_used(Allocator& allocator, Block* block, size_t size) {
+    if (block == nullptr) return nullptr;
+
+    trim_free(allocator, block, size);
+    mark_as_used(block);
+    return to_ptr(block);
+}
+
+}
+
+bool init(Allocator& allocator, size_t total_size) {
+    allocator.fl_bitmap = 0;
+    std::fill(allocator.sl_bitmap, allocator.sl_bitmap + FL_INDEX_COUNT, 0);
+    for (size_t fl = 0; fl < FL_INDEX_COUNT; fl++) {
+        std::fill(allocator.blocks[fl], allocator.blocks[fl] + SL_INDEX_COUNT, nullptr);
+    }
+
+    void* raw_memory = std::malloc(total_size);
+    if (raw_memory == nullptr) return false;
+
+    allocator.memory = raw_memory;
+    allocator.capacity = total_size;
+
+    uintptr_t current_addr = (uintptr_t) raw_memory;
+    uintptr_t aligned_addr = align_up(current_addr, ALIGN_SIZE);
+    size_t adjustment = aligned_addr - current_addr;
+
+    // one free block spanning the pool, followed by a zero sized used sentinel
+    // whose size field is the last word of the pool
+    size_t overhead = adjustment + BLOCK_START_OFFSET + BLOCK_OVERHEAD;
+    if (total_size < overhead + BLOCK_SIZE_MIN) {
+        std::free(raw_memory);
+        allocator.memory = nullptr;
+        allocator.capacity = 0;
+        return false; // memory too small to hold even one block
+    }
+
+    size_t pool_size = (total_size - overhead) & ~(ALIGN_SIZE - 1);
+    pool_size = std::min(pool_size, BLOCK_SIZE_MAX - ALIGN_SIZE);
+
+    Block* block = (Block*) aligned_addr;
+    block->size = 0;
+    set_size(block, pool_size);
+    set_free(block);
+    block_insert(allocator, block);
+
+    Block* sentinel = link_next(block);
+    sentinel->size = 0;
+    set_used(sentinel);
+    set_prev_free(sentinel);
+
+    return true;
+}
+
+void* alloc(Allocator& allocator, size_t size, size_t alignment) {
+    assert((alignment == 0 || (alignment & (alignment - 1)) == 0) && "alignment must be a power of 2");
+
+    size = std::max(size, (size_t)1);
+    size_t adjusted = adjust_request_size(size, ALIGN_SIZE);
+    if (adjusted == 0) return nullptr;
+
+    if (alignment <= ALIGN_SIZE) {
+        Block* block = locate_free(allocator, adjusted);
+        return prepare_used(allocator, block, adjusted);
+    }
+
+    // over-allocate so an aligned payload can always be found, the leading gap must
+    // be big enough to become a free block of its own
+    size_t gap_minimum = sizeof(Block);
+    size_t size_with_gap = adjust_request_size(adjusted + alignment + gap_minimum, alignment);
+    if (size_with_gap == 0) return nullptr;
+    Block* block = locate_free(allocator, size_with_gap);
+    if (block == nullptr) return nullptr;
+
+    uintptr_t ptr = (uintptr_t) to_ptr(block);
+    uintptr_t aligned = align_up(ptr, alignment);
+    size_t gap = aligned - ptr;
+
+    // gap too small for a block, move to the next aligned address
+    if (gap != 0 && gap < gap_minimum) {
+        size_t gap_remain = gap_minimum - gap;
+        size_t offset = std::max(gap_remain, alignment);
+        aligned = align_up(aligned + offset, alignment);
+        gap = aligned - ptr;
+    }
+
+    if (gap != 0) {
+        block = trim_free_leading(allocator, block, gap);
+    }
+
+    return prepare_used(allocator, block, adjusted);
+}
+
+void free(Allocator& allocator, void* ptr) {
+    if (ptr == nullptr) return;
+
+    assert(allocator.memory != nullptr && "allocator memory base must be initialized");
+    uint8_t* allocator_memory = (uint8_t*) allocator.memory;
+    assert(
+        allocator_memory <= (uint8_t*) ptr && (uint8_t*) ptr < (allocator_memory + allocator.capacity) &&
+        "pointer passed to free is outside allocator range"
+    );
+    (void)allocator_memory; // only read by the assert
+
+    Block* block = from_ptr(ptr);
+    assert(!is_free(block) && "block already freed");
+
+    mark_as_free(block);
+    block = merge_prev(allocator, block);
+    block = merge_next(allocator, block);
+    block_insert(allocator, block);
+}
+
+void* realloc(Allocator& allocator, void* ptr, size_t new_size) {
+    if (ptr == nullptr) return alloc(allocator, new_size, ALIGN_SIZE);
+    if (new_size == 0) {
+        free(allocator, ptr);
+        return nullptr;
+    }
+
+    Block* block = from_ptr(ptr);
+    Block* next = next_block(block);
+
+    size_t current_size = block_size(block);
+    size_t combined_size = current_size + block_size(next) + BLOCK_OVERHEAD;
+    size_t adjusted = adjust_request_size(new_size, ALIGN_SIZE);
+    if (adjusted == 0) return nullptr;
+
+    // grow into the next block when it is free and large enough, otherwise move
+    if (adjusted > current_size && (!is_free(next) || adjusted > combined_size)) {
+        void* new_ptr = alloc(allocator, new_size, ALIGN_SIZE);
+        if (new_ptr == nullptr) return nullptr; //failed allocation
+        std::memcpy(new_ptr, ptr, std::min(current_size, new_size));
+        free(allocator, ptr);
+        return new_ptr;
+    }
+
+    if (adjusted > current_size) {
+        merge_next(allocator, block);
+        mark_as_used(block);
+    }
+
+    // shrink (or trim what the merge brought in)
+    trim_used(allocator, block, adjusted);
+    return ptr;
+}
+
+void destroy(Allocator& allocator) {
+    if (allocator.memory) {
+        std::free(allocator.memory);
+        allocator.memory = nullptr;
+        allocator.capacity = 0;
+        allocator.fl_bitmap = 0;
+    }
+}
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "types.h"
+
+// two-level segregated fit: free blocks are binned by (first level = power of two,
+// second level = linear subdivision of that power of two), both levels have a bitmap,
+// so alloc and free are O(1) no matter how fragmented the heap is
+namespace TLSF {
+
+const size_t SL_INDEX_COUNT_LOG2 = 5;
+const size_t SL_INDEX_COUNT = 1 << SL_INDEX_COUNT_LOG2;
+const size_t ALIGN_SIZE_LOG2 = 3;
+const size_t ALIGN_SIZE = 1 << ALIGN_SIZE_LOG2;
+
+// blocks below SMALL_BLOCK_SIZE all share first level 0, split linearly in ALIGN_SIZE steps
+const size_t FL_INDEX_SHIFT = SL_INDEX_COUNT_LOG2 + ALIGN_SIZE_LOG2;
+const size_t FL_INDEX_MAX = 40; // largest block is 1 TiB
+const size_t FL_INDEX_COUNT = FL_INDEX_MAX - FL_INDEX_SHIFT + 1;
+const size_t SMALL_BLOCK_SIZE = 1 << FL_INDEX_SHIFT;
+
+struct Block {
+    Block* prev_phys; // only valid when the previous block is free (lives in its last word)
+    size_t size;      // payload size, low bits hold the free / prev-free flags
+    Block* next_free; // only valid when this block is free
+    Block* prev_free;
+};
+
+struct Allocator {
+    void* memory;
+    size_t capacity;
+    uint64_t fl_bitmap;
+    uint32_t sl_bitmap[FL_INDEX_COUNT];
+    Block* blocks[FL_INDEX_COUNT][SL_INDEX_COUNT];
+};
+
+bool init(Allocator& allocator, size_t total_size);
+
+void* alloc(Allocator& allocator, size_t size, size_t alignment);
+
+void free(Allocator& allocator, void* ptr);
+
+void* realloc(Allocator& allocator, void* ptr, size_t new_size);
+
+void destroy(Allocator& allocator);
+}
@@ -0,0 +1,98 @@
+#include "Trace.h"
+#include <atomic>
+#include <cstdio>
+
+namespace Trace {
+
+namespace {
+
+std::atomic<uint16_t> next_thread{0};
+
+uint16_t this_thread() {
+    thread_local uint16_t thread = next_thread.fetch_add(1);
+    return thread;
+}
+
+uint8_t log2_of(size_t alignment) {
+    return (uint8_t) __builtin_ctzll(std::max(alignment, (size_t)1));
+}
+
+// recorder lock must be held
+void push(Recorder& recorder, Op op, uint32_t id, size_t size, size_t alignment) {
+    Event event;
+    event.timestamp = recorder.clock++;
+    event.size = size;
+    event.id = id;
+    event.thread = this_thread();
+    event.op = (uint8_t) op;
+    event.alignment_log2 = log2_of(alignment);
+    recorder.events.push_back(event);
+}
+
+}
+
+void record_alloc(Recorder& recorder, void* ptr, size_t size, size_t alignment) {
+    uint32_t id = recorder.next_id++;
+    recorder.ids[ptr] = id;
+    push(recorder, Op::Alloc, id, size, alignment);
+}
+
+void record_free(Recorder& recorder, void* ptr) {
+    auto it = recorder.ids.find(ptr);
+    if (it == recorder.ids.end()) return;
+
+    push(recorder, Op::Free, it->second, 0, 1);
+    recorder.ids.erase(it);
+}
+
+void record_realloc(Recorder& recorder, void* old_ptr, void* new_ptr, size_t new_size) {
+    auto it = recorder.ids.find(old_ptr);
+    if (it == recorder.ids.end()) return;
+
+    uint32_t id = it->second;
+    recorder.ids.erase(it);
+    recorder.ids[new_ptr] = id;
+    push(recorder, Op::Realloc, id, new_size, MIN_ALIGNMENT);
+}
+
+bool save(Recorder& recorder, const char* path) {
+    std::lock_guard<std::mutex> guard(recorder.lock);
+
+    FILE* file = std::fopen(path, "wb");
+    if (file == nullptr) return false;
+
+    FileHeader header;
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.event_count = recorder.events.size();
+
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+    if (ok && !recorder.events.empty()) {
+        ok = std::fwrite(recorder.events.data(), sizeof(Event), recorder.events.size(), file) == recorder.events.size();
+    }
+    return std::fclose(file) == 0 && ok;
+}
+
+bool load(const char* path, std::vector<Event>& events) {
+    FILE* file = std::fopen(path, "rb");
+    if (file == nullptr) return false;
+
+    FileHeader header;
+    bool ok = std::fread(&header, sizeof(header), 1, file) == 1 &&
+              std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 &&
+              header.version == VERSION;
+
+    if (ok) {
+        events.resize(header.event_count);
+        ok = std::fread(events.data(), sizeof(Event), events.size(), file) == events.size();
+    }
+    std::fclose(file);
+
+    // threads recorded concurrently can land out of order, replay wants clock order
+    if (ok) {
+        std::sort(events.begin(), events.end(), [](const Event& a, const Event& b) { return a.timestamp < b.timestamp; });
+    }
+    return ok;
+}
+
+}
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <stdint.h>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "LinearAllocator.h"
+
+// allocation traces: every alloc, free and realloc that goes through a Recording allocator
+// is logged as a fixed size Event, traces are saved as a small header followed by the raw events.
+// replay runs a trace against any allocator, so allocator choices can be tuned offline
+// against captured workloads
+namespace Trace {
+
+enum class Op : uint8_t {
+    Alloc,
+    Free,
+    Realloc,
+};
+
+// blocks are named by id instead of address, ids are handed out in allocation order
+// starting at 0 and a block keeps its id across realloc
+struct Event {
+    uint64_t timestamp; // logical clock, one tick per event across all threads
+    uint64_t size;      // requested bytes, 0 for free
+    uint32_t id;
+    uint16_t thread;    // small per-thread number, in order of the threads' first event
+    uint8_t op;         // Op
+    uint8_t alignment_log2;
+};
+
+static_assert(sizeof(Event) == 24, "events are written to disk as they are");
+
+const char MAGIC[4] = {'A', 'T', 'R', 'C'};
+const uint32_t VERSION = 1;
+
+struct FileHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t event_count;
+};
+
+struct Recorder {
+    std::mutex lock;
+    std::vector<Event> events;
+    std::unordered_map<void*, uint32_t> ids; // live blocks
+    uint32_t next_id = 0;
+    uint64_t clock = 0;
+};
+
+// the record functions expect the recorder lock to be held, and held across the backend call
+// the event is for. otherwise another thread can get the same address back from the backend and
+// log it before this event lands, and replay hands its id to the wrong block
+void record_alloc(Recorder& recorder, void* ptr, size_t size, size_t alignment);
+
+// pointers the recorder never saw allocated (from before recording started) are ignored
+void record_free(Recorder& recorder, void* ptr);
+
+void record_realloc(Recorder& recorder, void* old_ptr, void* new_ptr, size_t new_size);
+
+bool save(Recorder& recorder, const char* path);
+
+bool load(const char* path, std::vector<Event>& events);
+
+// the recording shim: sits in front of any allocator with alloc/free (and realloc) next to it
+// in its namespace, logs every call and forwards it. works with STLAllocator like the backend does.
+// calls through one recorder are serialized, each one holds the recorder lock from the backend
+// call until its event is logged
+template <typename Backend>
+struct Recording {
+    Backend* backend;
+    Recorder* recorder;
+};
+
+template <typename Backend>
+void* alloc(Recording<Backend>& recording, size_t size, size_t alignment) {
+    std::lock_guard<std::mutex> guard(recording.recorder->lock);
+    void* ptr = alloc(*recording.backend, size, alignment);
+    if (ptr != nullptr) record_alloc(*recording.recorder, ptr, size, alignment);
+    return ptr;
+}
+
+template <typename Backend>
+void free(Recording<Backend>& recording, void* ptr) {
+    if (ptr == nullptr) return;
+    std::lock_guard<std::mutex> guard(recording.recorder->lock);
+    record_free(*recording.recorder, ptr);
+    free(*recording.backend, ptr);
+}
+
+template <typename Backend>
+void* realloc(Recording<Backend>& recording, void* ptr, size_t new_size) {
+    std::lock_guard<std::mutex> guard(recording.recorder->lock);
+    void* new_ptr = realloc(*recording.backend, ptr, new_size);
+    if (ptr == nullptr) {
+        if (new_ptr != nullptr) record_alloc(*recording.recorder, new_ptr, new_size, MIN_ALIGNMENT);
+    } else if (new_size == 0) {
+        record_free(*recording.recorder, ptr);
+    } else if (new_ptr != nullptr) {
+        record_realloc(*recording.recorder, ptr, new_ptr, new_size);
+    }
+    return new_ptr;
+}
+
+struct ReplayResult {
+    size_t ops;
+    size_t failed;         // allocations the backend could not serve
+    double seconds;
+    size_t peak_live;      // most requested bytes alive at once
+    size_t peak_footprint; // highest arena offset ever touched, 0 when no arena base was given
+    double fragmentation;  // share of the peak footprint that live data never needed, 1 - peak_live / peak_footprint
+};
+
+// replays events in timestamp order on the calling thread against backend.
+// arena_base is where backend's memory starts, it is what the footprint is measured from
+template <typename Backend>
+ReplayResult replay(const std::vector<Event>& events, Backend& backend, const void* arena_base = nullptr) {
+    ReplayResult result = {};
+
+    std::vector<void*> ptrs;
+    std::vector<size_t> sizes;
+    size_t live = 0;
+
+    auto touch = [&](void* ptr, size_t size) {
+        if (arena_base == nullptr || ptr == nullptr) return;
+        size_t end = (uint8_t*) ptr + size - (const uint8_t*) arena_base;
+        if (end > result.peak_footprint) result.peak_footprint = end;
+    };
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (const Event& event : events) {
+        if (event.id >= ptrs.size()) {
+            ptrs.resize(event.id + 1, nullptr);
+            sizes.resize(event.id + 1, 0);
+        }
+        void*& ptr = ptrs[event.id];
+
+        switch ((Op) event.op) {
+            case Op::Alloc:
+                ptr = alloc(backend, event.size, (size_t)1 << event.alignment_log2);
+                if (ptr == nullptr) {
+                    result.failed++;
+                    break;
+                }
+                sizes[event.id] = event.size;
+                live += event.size;
+                touch(ptr, event.size);
+                break;
+
+            case Op::Free:
+                if (ptr == nullptr) break; // its allocation failed
+                free(backend, ptr);
+                live -= sizes[event.id];
+                ptr = nullptr;
+                break;
+
+            case Op::Realloc: {
+                if (ptr == nullptr) break;
+                void* new_ptr;
+                if constexpr (std::is_same_v<Backend, Linear::Allocator>) {
+                    // no realloc on a bump arena, move it like a container would
+                    new_ptr = alloc(backend, event.size, MIN_ALIGNMENT);
+                    if (new_ptr != nullptr) std::memcpy(new_ptr, ptr, std::min(sizes[event.id], (size_t)event.size));
+                } else {
+                    new_ptr = realloc(backend, ptr, event.size);
+                }
+                if (new_ptr == nullptr) {
+                    result.failed++;
+                    break;
+                }
+                live = live - sizes[event.id] + event.size;
+                sizes[event.id] = event.size;
+                ptr = new_ptr;
+                touch(ptr, event.size);
+                break;
+            }
+        }
+
+        result.peak_live = std::max(result.peak_live, live);
+        result.ops++;
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (result.peak_footprint != 0) {
+        result.fragmentation = 1.0 - (double) result.peak_live / result.peak_footprint;
+    }
+    return result;
+}
+
+}
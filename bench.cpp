@@ -0,0 +1,544 @@
+#include "BasicFreeList.h"
+#include "ConcurrentFreeListAllocator.h"
+#include "ConcurrentLinearAllocator.h"
+#include "FreeListAllocator.h"
+#include "LinearAllocator.h"
+#include "STLAllocator.h"
+#include "SystemMalloc.h"
+#include "TLSFAllocator.h"
+#include "types.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <list>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// microbenchmarks of every general purpose allocator against std::malloc.
+// build and run with `make bench`, which sets the optimization level explicitly.
+// output is CSV on stdout, or JSON with --json
+
+#ifndef BENCH_OPT_LEVEL
+#define BENCH_OPT_LEVEL 0
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const size_t ARENA_SIZE = 64 * 1024 * 1024;
+const size_t LIVE_OBJECTS = 1000; // allocations alive at once in the alloc/free cases
+const size_t ROUNDS = 50;
+
+struct Row {
+    std::string benchmark;
+    std::string backend;
+    std::string sizes;
+    size_t alignment;
+    std::string order;
+    size_t ops;
+    double ns_per_op;
+    double p50_ns;  // latency percentiles (clock read included) are 0 where a case does not time single operations
+    double p99_ns;
+    double p999_ns;
+    size_t bytes;   // arena footprint, only for the footprint case
+};
+
+std::vector<Row> rows;
+
+enum class SizeDistribution { Small, Medium, Mixed };
+enum class FreeOrder { LIFO, FIFO, Random };
+
+const char* name_of(SizeDistribution sizes) {
+    switch (sizes) {
+        case SizeDistribution::Small: return "8-64";
+        case SizeDistribution::Medium: return "64-1024";
+        case SizeDistribution::Mixed: return "mixed";
+    }
+    return "";
+}
+
+const char* name_of(FreeOrder order) {
+    switch (order) {
+        case FreeOrder::LIFO: return "lifo";
+        case FreeOrder::FIFO: return "fifo";
+        case FreeOrder::Random: return "random";
+    }
+    return "";
+}
+
+// mixed is mostly small objects with a long tail, roughly what a real heap sees
+std::vector<size_t> make_sizes(SizeDistribution distribution, size_t count, std::mt19937& rng) {
+    std::vector<size_t> sizes(count);
+    for (size_t& size : sizes) {
+        switch (distribution) {
+            case SizeDistribution::Small: size = std::uniform_int_distribution<size_t>(8, 64)(rng); break;
+            case SizeDistribution::Medium: size = std::uniform_int_distribution<size_t>(64, 1024)(rng); break;
+            case SizeDistribution::Mixed: {
+                int bucket = std::uniform_int_distribution<int>(0, 99)(rng);
+                if (bucket < 90) size = std::uniform_int_distribution<size_t>(8, 128)(rng);
+                else if (bucket < 99) size = std::uniform_int_distribution<size_t>(128, 4096)(rng);
+                else size = std::uniform_int_distribution<size_t>(4096, 65536)(rng);
+                break;
+            }
+        }
+    }
+    return sizes;
+}
+
+std::vector<size_t> make_free_order(FreeOrder order, size_t count, std::mt19937& rng) {
+    std::vector<size_t> indices(count);
+    for (size_t i = 0; i < count; i++) indices[i] = i;
+    if (order == FreeOrder::LIFO) std::reverse(indices.begin(), indices.end());
+    if (order == FreeOrder::Random) std::shuffle(indices.begin(), indices.end(), rng);
+    return indices;
+}
+
+double elapsed_ns(Clock::time_point start, Clock::time_point end) {
+    return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+double percentile(std::vector<double>& samples, double p) {
+    if (samples.empty()) return 0;
+    size_t index = std::min(samples.size() - 1, (size_t)(p * samples.size()));
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return samples[index];
+}
+
+// bump arenas never give single blocks back, they are rewound once per round instead
+template <typename Backend>
+void end_round(Backend& allocator) {
+    if constexpr (std::is_same_v<Backend, Linear::Allocator>) {
+        Linear::reset(allocator);
+    } else {
+        (void)allocator;
+    }
+}
+
+// LIVE_OBJECTS allocations, then all of them freed in the given order, ROUNDS times.
+// one pass measures throughput, a second one times every operation for the percentiles
+template <typename Backend>
+void bench_alloc_free(const char* backend, Backend& allocator, SizeDistribution distribution, size_t alignment, FreeOrder order) {
+    std::mt19937 rng(42);
+    std::vector<size_t> sizes = make_sizes(distribution, LIVE_OBJECTS, rng);
+    std::vector<size_t> free_order = make_free_order(order, LIVE_OBJECTS, rng);
+    std::vector<void*> ptrs(LIVE_OBJECTS);
+
+    Clock::time_point start = Clock::now();
+    for (size_t round = 0; round < ROUNDS; round++) {
+        for (size_t i = 0; i < LIVE_OBJECTS; i++) ptrs[i] = alloc(allocator, sizes[i], alignment);
+        for (size_t i : free_order) free(allocator, ptrs[i]);
+        end_round(allocator);
+    }
+    double total_ns = elapsed_ns(start, Clock::now());
+    size_t ops = 2 * ROUNDS * LIVE_OBJECTS;
+
+    std::vector<double> latencies;
+    latencies.reserve(ops);
+    for (size_t round = 0; round < ROUNDS; round++) {
+        for (size_t i = 0; i < LIVE_OBJECTS; i++) {
+            Clock::time_point t0 = Clock::now();
+            ptrs[i] = alloc(allocator, sizes[i], alignment);
+            latencies.push_back(elapsed_ns(t0, Clock::now()));
+        }
+        for (size_t i : free_order) {
+            Clock::time_point t0 = Clock::now();
+            free(allocator, ptrs[i]);
+            latencies.push_back(elapsed_ns(t0, Clock::now()));
+        }
+        end_round(allocator);
+    }
+
+    double p50 = percentile(latencies, 0.50);
+    double p99 = percentile(latencies, 0.99);
+    double p999 = percentile(latencies, 0.999);
+    rows.push_back(Row{"alloc_free", backend, name_of(distribution), alignment, name_of(order), ops, total_ns / ops, p50, p99, p999, 0});
+}
+
+// one buffer grown either by doubling or in small steps, the case realloc in place is for
+template <typename Backend>
+void bench_realloc(const char* backend, Backend& allocator, bool doubling) {
+    const size_t MAX_SIZE = doubling ? 64 * 1024 : 8 * 1024;
+
+    size_t ops = 0;
+    std::vector<double> latencies;
+    Clock::time_point start = Clock::now();
+    for (size_t round = 0; round < ROUNDS; round++) {
+        size_t size = 16;
+        void* ptr = alloc(allocator, size, MIN_ALIGNMENT);
+        while (size < MAX_SIZE) {
+            size = doubling ? size * 2 : size + 16;
+            Clock::time_point t0 = Clock::now();
+            ptr = realloc(allocator, ptr, size);
+            latencies.push_back(elapsed_ns(t0, Clock::now()));
+            std::memset(ptr, (int)round, 16); // touch it, so nothing gets optimized away
+            ops++;
+        }
+        free(allocator, ptr);
+    }
+    double total_ns = elapsed_ns(start, Clock::now());
+
+    double p50 = percentile(latencies, 0.50);
+    double p99 = percentile(latencies, 0.99);
+    double p999 = percentile(latencies, 0.999);
+    rows.push_back(Row{doubling ? "realloc_double" : "realloc_step", backend, doubling ? "16-65536" : "16-8192", MIN_ALIGNMENT, "", ops, total_ns / ops, p50, p99, p999, 0});
+}
+
+// container workloads through STLAllocator, reported per element operation
+template <typename Backend>
+void bench_stl(const char* backend, Backend& allocator) {
+    const int ELEMENTS = 20000;
+
+    {
+        using Vec = std::vector<int, STLAllocator<int, Backend>>;
+        Clock::time_point start = Clock::now();
+        for (size_t round = 0; round < ROUNDS; round++) {
+            Vec vec{STLAllocator<int, Backend>(allocator)};
+            for (int i = 0; i < ELEMENTS; i++) vec.push_back(i);
+            end_round(allocator);
+        }
+        size_t ops = ROUNDS * ELEMENTS;
+        rows.push_back(Row{"stl_vector_push", backend, "", alignof(int), "", ops, elapsed_ns(start, Clock::now()) / ops, 0, 0, 0, 0});
+    }
+
+    {
+        using Map = std::map<int, int, std::less<int>, STLAllocator<std::pair<const int, int>, Backend>>;
+        Clock::time_point start = Clock::now();
+        for (size_t round = 0; round < ROUNDS / 10; round++) {
+            Map map{STLAllocator<std::pair<const int, int>, Backend>(allocator)};
+            for (int i = 0; i < ELEMENTS; i++) map[(i * 7919) % ELEMENTS] = i;
+            for (int i = 0; i < ELEMENTS; i += 2) map.erase(i);
+            map.clear();
+            end_round(allocator);
+        }
+        size_t ops = (ROUNDS / 10) * (ELEMENTS + ELEMENTS / 2);
+        rows.push_back(Row{"stl_map_insert_erase", backend, "", alignof(std::pair<const int, int>), "", ops, elapsed_ns(start, Clock::now()) / ops, 0, 0, 0, 0});
+    }
+
+    {
+        using List = std::list<int, STLAllocator<int, Backend>>;
+        Clock::time_point start = Clock::now();
+        for (size_t round = 0; round < ROUNDS / 10; round++) {
+            List list{STLAllocator<int, Backend>(allocator)};
+            for (int i = 0; i < ELEMENTS; i++) list.push_back(i);
+            list.remove_if([](int v) { return v % 3 == 0; });
+            list.clear();
+            end_round(allocator);
+        }
+        size_t ops = (ROUNDS / 10) * ELEMENTS * 2;
+        rows.push_back(Row{"stl_list_push_remove", backend, "", alignof(int), "", ops, elapsed_ns(start, Clock::now()) / ops, 0, 0, 0, 0});
+    }
+
+    {
+        using String = std::basic_string<char, std::char_traits<char>, STLAllocator<char, Backend>>;
+        Clock::time_point start = Clock::now();
+        for (size_t round = 0; round < ROUNDS; round++) {
+            String str{STLAllocator<char, Backend>(allocator)};
+            for (int i = 0; i < ELEMENTS; i++) str += "abcdefgh";
+            end_round(allocator);
+        }
+        size_t ops = ROUNDS * ELEMENTS;
+        rows.push_back(Row{"stl_string_append", backend, "", 1, "", ops, elapsed_ns(start, Clock::now()) / ops, 0, 0, 0, 0});
+    }
+}
+
+// runs the whole suite against one backend, init sets up a fresh allocator for every case
+template <typename Backend, typename Init>
+void bench_backend(const char* backend, Init init) {
+    constexpr bool has_realloc = !std::is_same_v<Backend, Linear::Allocator>;
+
+    for (SizeDistribution distribution : {SizeDistribution::Small, SizeDistribution::Medium, SizeDistribution::Mixed}) {
+        for (size_t alignment : {(size_t)8, (size_t)64}) {
+            for (FreeOrder order : {FreeOrder::LIFO, FreeOrder::FIFO, FreeOrder::Random}) {
+                Backend allocator;
+                if (!init(allocator)) continue;
+                bench_alloc_free(backend, allocator, distribution, alignment, order);
+                destroy(allocator);
+            }
+        }
+    }
+
+    if constexpr (has_realloc) {
+        for (bool doubling : {true, false}) {
+            Backend allocator;
+            if (!init(allocator)) continue;
+            bench_realloc(backend, allocator, doubling);
+            destroy(allocator);
+        }
+    }
+
+    Backend allocator;
+    if (init(allocator)) {
+        bench_stl(backend, allocator);
+        destroy(allocator);
+    }
+}
+
+// a decoder's pattern: MESSAGE_OBJECTS same sized objects per message, all freed together,
+// one by one against alloc_batch/free_batch. a fragmented heap sits around them
+void bench_batch() {
+    const size_t MESSAGE_OBJECTS = 32;
+    const size_t MESSAGES = ROUNDS * 100;
+
+    for (FreeList::FitPolicy policy : {FreeList::FitPolicy::FirstFit, FreeList::FitPolicy::Segregated}) {
+        const char* backend = policy == FreeList::FitPolicy::FirstFit ? "freelist_firstfit" : "freelist_segregated";
+
+        for (bool batched : {false, true}) {
+            FreeList::Allocator allocator;
+            if (!FreeList::init(allocator, ARENA_SIZE, policy)) continue;
+
+            std::mt19937 rng(42);
+            std::vector<size_t> sizes = make_sizes(SizeDistribution::Mixed, LIVE_OBJECTS, rng);
+            std::vector<void*> background(LIVE_OBJECTS);
+            for (size_t i = 0; i < LIVE_OBJECTS; i++) background[i] = FreeList::alloc(allocator, sizes[i], MIN_ALIGNMENT);
+            for (size_t i = 0; i < LIVE_OBJECTS; i += 2) FreeList::free(allocator, background[i]);
+
+            void* objects[MESSAGE_OBJECTS];
+            Clock::time_point start = Clock::now();
+            for (size_t message = 0; message < MESSAGES; message++) {
+                if (batched) {
+                    FreeList::alloc_batch(allocator, 64, MIN_ALIGNMENT, objects, MESSAGE_OBJECTS);
+                    FreeList::free_batch(allocator, objects, MESSAGE_OBJECTS);
+                } else {
+                    for (void*& object : objects) object = FreeList::alloc(allocator, 64, MIN_ALIGNMENT);
+                    for (void* object : objects) FreeList::free(allocator, object);
+                }
+            }
+            double total_ns = elapsed_ns(start, Clock::now());
+            size_t ops = 2 * MESSAGES * MESSAGE_OBJECTS;
+
+            rows.push_back(Row{"message_objects", backend, "64", MIN_ALIGNMENT, batched ? "batch" : "single", ops, total_ns / ops, 0, 0, 0, 0});
+            FreeList::destroy(allocator);
+        }
+    }
+}
+
+// a page aligned buffer that has to move to grow (a block sits right behind it), from a
+// malloc'd arena (streamed copy) and an mmap backed one (its pages are moved with mremap).
+// the buffer is written before every realloc, so the copy reads warm-ish memory like a real one would
+void bench_realloc_move() {
+    const size_t page = Pages::page_size();
+
+    for (bool mmap_backed : {false, true}) {
+        const char* backend = mmap_backed ? "freelist_segregated_mmap" : "freelist_segregated";
+
+        for (size_t size : {(size_t) 256 * 1024, (size_t) 2 * 1024 * 1024, (size_t) 4 * 1024 * 1024, (size_t) 16 * 1024 * 1024}) {
+            FreeList::Options options;
+            options.policy = FreeList::FitPolicy::Segregated;
+            options.mmap_backed = mmap_backed;
+            FreeList::Allocator allocator;
+            if (!FreeList::init(allocator, ARENA_SIZE, options)) continue;
+
+            std::vector<double> latencies;
+            for (size_t round = 0; round < ROUNDS; round++) {
+                void* ptr = FreeList::alloc(allocator, size, page);
+                std::memset(ptr, (int)round, size);
+                void* blocker = FreeList::alloc(allocator, 64, MIN_ALIGNMENT);
+
+                Clock::time_point t0 = Clock::now();
+                ptr = FreeList::realloc(allocator, ptr, size * 2);
+                latencies.push_back(elapsed_ns(t0, Clock::now()));
+
+                FreeList::free(allocator, blocker);
+                FreeList::free(allocator, ptr);
+            }
+
+            double total_ns = 0;
+            for (double ns : latencies) total_ns += ns;
+            std::string sizes = std::to_string(size / 1024) + "K";
+            rows.push_back(Row{"realloc_move", backend, sizes, page, "", ROUNDS, total_ns / ROUNDS,
+                percentile(latencies, 0.50), percentile(latencies, 0.99), percentile(latencies, 0.999), 0});
+            FreeList::destroy(allocator);
+        }
+    }
+}
+
+// every thread bumps the same arena: a Linear behind a mutex, the shared atomic offset of
+// ConcurrentLinear and its per-thread sub-chunks. thread counts double from 1 up to the
+// hardware threads (at least 4), ns_per_op is wall time over the allocations of all threads
+void bench_linear_scaling() {
+    const size_t OPS_PER_THREAD = 100000;
+    const size_t MAX_SIZE = 64;
+
+    size_t max_threads = std::max<size_t>(4, std::thread::hardware_concurrency());
+    std::mt19937 rng(42);
+    std::vector<size_t> sizes = make_sizes(SizeDistribution::Small, OPS_PER_THREAD, rng);
+
+    for (size_t thread_count = 1; thread_count <= max_threads; thread_count *= 2) {
+        size_t arena_size = thread_count * (OPS_PER_THREAD * MAX_SIZE + 2 * ConcurrentLinear::CLAIM_SIZE);
+
+        // runs body(thread_index) on thread_count threads at once and returns the wall time
+        auto timed = [&](auto body) {
+            std::atomic<bool> go{false};
+            std::vector<std::thread> threads;
+            for (size_t t = 0; t < thread_count; t++) {
+                threads.emplace_back([&, t]() {
+                    while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+                    body(t);
+                });
+            }
+            Clock::time_point start = Clock::now();
+            go.store(true, std::memory_order_release);
+            for (auto& thread : threads) thread.join();
+            return elapsed_ns(start, Clock::now());
+        };
+
+        size_t ops = thread_count * OPS_PER_THREAD;
+        std::string threads_label = std::to_string(thread_count) + "_threads";
+
+        {
+            Linear::Allocator allocator;
+            if (!Linear::init(allocator, arena_size)) continue;
+            std::mutex lock;
+            double total_ns = timed([&](size_t) {
+                for (size_t size : sizes) {
+                    std::lock_guard<std::mutex> guard(lock);
+                    Linear::alloc(allocator, size, MIN_ALIGNMENT);
+                }
+            });
+            rows.push_back(Row{"linear_scaling", "linear_mutex", name_of(SizeDistribution::Small), MIN_ALIGNMENT, threads_label, ops, total_ns / ops, 0, 0, 0, 0});
+            Linear::destroy(allocator);
+        }
+
+        for (bool local : {false, true}) {
+            ConcurrentLinear::Allocator allocator;
+            if (!ConcurrentLinear::init(allocator, arena_size)) continue;
+            double total_ns = timed([&](size_t) {
+                ConcurrentLinear::Participant participant(allocator);
+                ConcurrentLinear::LocalArena arena;
+                ConcurrentLinear::attach(arena, allocator);
+                for (size_t size : sizes) {
+                    if (local) ConcurrentLinear::alloc(arena, size, MIN_ALIGNMENT);
+                    else ConcurrentLinear::alloc(allocator, size, MIN_ALIGNMENT);
+                }
+            });
+            const char* backend = local ? "concurrent_linear_local" : "concurrent_linear_shared";
+            rows.push_back(Row{"linear_scaling", backend, name_of(SizeDistribution::Small), MIN_ALIGNMENT, threads_label, ops, total_ns / ops, 0, 0, 0, 0});
+            ConcurrentLinear::destroy(allocator);
+        }
+    }
+}
+
+// bytes a run of small objects takes up with and without per-allocation headers
+void bench_footprint() {
+    const size_t COUNT = 1000;
+
+    for (size_t size : {8, 16, 24}) {
+        for (bool headers : {true, false}) {
+            Linear::Options options;
+            options.headers = headers;
+            Linear::Allocator allocator;
+            if (!Linear::init(allocator, (size + 64) * COUNT, options)) continue;
+            for (size_t i = 0; i < COUNT; i++) Linear::alloc(allocator, size, MIN_ALIGNMENT);
+            rows.push_back(Row{"footprint", headers ? "linear_headers" : "linear", std::to_string(size), MIN_ALIGNMENT, "", COUNT, 0, 0, 0, 0, Linear::getUsed(allocator)});
+            Linear::destroy(allocator);
+        }
+
+        for (bool compact : {false, true}) {
+            FreeList::Options options;
+            options.compact_headers = compact;
+            FreeList::Allocator allocator;
+            if (!FreeList::init(allocator, (size + 64) * COUNT, options)) continue;
+
+            // blocks are carved back to back, first to one past the last is the footprint
+            uint8_t* first = (uint8_t*) FreeList::alloc(allocator, size, MIN_ALIGNMENT);
+            uint8_t* last = first;
+            for (size_t i = 1; i < COUNT; i++) last = (uint8_t*) FreeList::alloc(allocator, size, MIN_ALIGNMENT);
+            size_t bytes = (last - first) + (last - first) / (COUNT - 1);
+
+            rows.push_back(Row{"footprint", compact ? "freelist_compact" : "freelist", std::to_string(size), MIN_ALIGNMENT, "", COUNT, 0, 0, 0, 0, bytes});
+            FreeList::destroy(allocator);
+        }
+    }
+}
+
+void print_csv() {
+    std::cout << "benchmark,backend,sizes,alignment,order,ops,ns_per_op,p50_ns,p99_ns,p999_ns,bytes,opt_level" << std::endl;
+    for (const Row& row : rows) {
+        std::cout << row.benchmark << "," << row.backend << "," << row.sizes << "," << row.alignment << ","
+                  << row.order << "," << row.ops << "," << row.ns_per_op << "," << row.p50_ns << ","
+                  << row.p99_ns << "," << row.p999_ns << "," << row.bytes << ",O" << BENCH_OPT_LEVEL << std::endl;
+    }
+}
+
+void print_json() {
+    std::cout << "{\"opt_level\": \"O" << BENCH_OPT_LEVEL << "\", \"results\": [" << std::endl;
+    for (size_t i = 0; i < rows.size(); i++) {
+        const Row& row = rows[i];
+        std::cout << "  {\"benchmark\": \"" << row.benchmark << "\", \"backend\": \"" << row.backend
+                  << "\", \"sizes\": \"" << row.sizes << "\", \"alignment\": " << row.alignment
+                  << ", \"order\": \"" << row.order << "\", \"ops\": " << row.ops
+                  << ", \"ns_per_op\": " << row.ns_per_op << ", \"p50_ns\": " << row.p50_ns
+                  << ", \"p99_ns\": " << row.p99_ns << ", \"p999_ns\": " << row.p999_ns
+                  << ", \"bytes\": " << row.bytes << "}" << (i + 1 < rows.size() ? "," : "") << std::endl;
+    }
+    std::cout << "]}" << std::endl;
+}
+
+}
+
+int main(int argc, char** argv) {
+    bool json = argc > 1 && std::strcmp(argv[1], "--json") == 0;
+
+    bench_backend<SystemMalloc::Allocator>("malloc", [](SystemMalloc::Allocator&) { return true; });
+
+    bench_backend<FreeList::Allocator>("freelist_firstfit", [](FreeList::Allocator& allocator) {
+        return FreeList::init(allocator, ARENA_SIZE, FreeList::FitPolicy::FirstFit);
+    });
+    bench_backend<FreeList::Allocator>("freelist_segregated", [](FreeList::Allocator& allocator) {
+        return FreeList::init(allocator, ARENA_SIZE, FreeList::FitPolicy::Segregated);
+    });
+    bench_backend<FreeList::Allocator>("freelist_segregated_cached", [](FreeList::Allocator& allocator) {
+        FreeList::Options options;
+        options.policy = FreeList::FitPolicy::Segregated;
+        options.front_cache = true;
+        return FreeList::init(allocator, ARENA_SIZE, options);
+    });
+    bench_backend<FreeList::Allocator>("freelist_segregated_sized", [](FreeList::Allocator& allocator) {
+        FreeList::Options options;
+        options.policy = FreeList::FitPolicy::Segregated;
+        options.size_classes = true;
+        return FreeList::init(allocator, ARENA_SIZE, options);
+    });
+    bench_backend<FreeList::Allocator>("freelist_bestfit", [](FreeList::Allocator& allocator) {
+        return FreeList::init(allocator, ARENA_SIZE, FreeList::FitPolicy::BestFit);
+    });
+    bench_backend<FreeList::Allocator>("freelist_aobestfit", [](FreeList::Allocator& allocator) {
+        return FreeList::init(allocator, ARENA_SIZE, FreeList::FitPolicy::AddressOrderedBestFit);
+    });
+    // the same heaps with everything fixed at compile time
+    bench_backend<BasicFreeList<FreeListPolicy<FreeList::FitPolicy::FirstFit>>>("basic_freelist_firstfit", [](auto& allocator) {
+        return init(allocator, ARENA_SIZE);
+    });
+    bench_backend<BasicFreeList<FreeListPolicy<FreeList::FitPolicy::Segregated>>>("basic_freelist_segregated", [](auto& allocator) {
+        return init(allocator, ARENA_SIZE);
+    });
+    bench_backend<TLSF::Allocator>("tlsf", [](TLSF::Allocator& allocator) {
+        return TLSF::init(allocator, ARENA_SIZE);
+    });
+    bench_backend<ConcurrentFreeList::Allocator>("concurrent_freelist", [](ConcurrentFreeList::Allocator& allocator) {
+        return ConcurrentFreeList::init(allocator, ARENA_SIZE);
+    });
+    bench_backend<Linear::Allocator>("linear", [](Linear::Allocator& allocator) {
+        Linear::Options options;
+        options.growable = true;
+        return Linear::init(allocator, ARENA_SIZE, options);
+    });
+
+    bench_batch();
+    bench_realloc_move();
+    bench_linear_scaling();
+    bench_footprint();
+
+    if (json) print_json();
+    else print_csv();
+
+    return 0;
+}
@@ -1,40 +1,57 @@
+#include "ConcurrentFreeListAllocator.h"
+#include "ConcurrentLinearAllocator.h"
 #include "FreeListAllocator.h"
+#include "LinearAllocator.h"
+#include "MemoryResource.h"
 #include "STLAllocator.h"
+#include "TLSFAllocator.h"
+#include "Trace.h"
 #include "types.h"
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
+#include <cstdio>
 #include <cstring>
 #include <vector>
 #include <ctime>
 #include <cassert>
+#include <list>
 #include <map>
+#include <memory_resource>
+#include <mutex>
+#include <random>
 #include <string>
+#include <thread>
+#include <type_traits>
 #include <utility>
 
-// type defs for stl test
-using CharAllocator = STLAllocator<char>;
-using MyString = std::basic_string<char, std::char_traits<char>, CharAllocator>;
-using StringAllocator = STLAllocator<MyString>;
-using MyVec = std::vector<MyString, StringAllocator>;
-using MapAllocator = STLAllocator<std::pair<const MyString, MyVec>>;
-using MyMap = std::map<MyString, MyVec, std::less<MyString>, MapAllocator>;
-
-static MyString make_my_string(const std::string& s, const CharAllocator& alloc) {
-    return MyString(s.c_str(), alloc);
+// type defs for stl test, one set per backend
+template <typename Backend> using CharAllocator = STLAllocator<char, Backend>;
+template <typename Backend> using MyString = std::basic_string<char, std::char_traits<char>, CharAllocator<Backend>>;
+template <typename Backend> using StringAllocator = STLAllocator<MyString<Backend>, Backend>;
+template <typename Backend> using MyVec = std::vector<MyString<Backend>, StringAllocator<Backend>>;
+template <typename Backend> using MapAllocator = STLAllocator<std::pair<const MyString<Backend>, MyVec<Backend>>, Backend>;
+template <typename Backend> using MyMap = std::map<MyString<Backend>, MyVec<Backend>, std::less<MyString<Backend>>, MapAllocator<Backend>>;
+
+template <typename Backend>
+static MyString<Backend> make_my_string(const std::string& s, const CharAllocator<Backend>& alloc) {
+    return MyString<Backend>(s.c_str(), alloc);
 }
 
+template <typename Backend>
 static void assert_map_matches_expected(
-    const MyMap& map,
+    const MyMap<Backend>& map,
     const std::map<std::string, std::vector<std::string>>& expected,
-    const CharAllocator& alloc
+    const CharAllocator<Backend>& alloc
 ) {
     assert(map.size() == expected.size());
 
     for (const auto& [key_std, expected_values] : expected) {
-        MyString key = make_my_string(key_std, alloc);
+        MyString<Backend> key = make_my_string(key_std, alloc);
         auto it = map.find(key);
         assert(it != map.end());
 
-        const MyVec& values = it->second;
+        const MyVec<Backend>& values = it->second;
         assert(values.size() == expected_values.size());
 
         for (size_t i = 0; i < expected_values.size(); ++i) {
@@ -43,24 +60,44 @@ static void assert_map_matches_expected(
     }
 }
 
-void stl_test() {
-    std::cout << "starting stl test ..." << std::endl;
+// number of blocks across whichever free structure the policy uses, the front cache is
+// flushed first so its blocks are counted (and merged)
+static size_t count_free_blocks(FreeList::Allocator& allocator) {
+    FreeList::flushFrontCache(allocator);
+    return FreeList::getStats(allocator).free_block_count;
+}
 
-    const size_t BUFFER_SIZE = 1024 * 1024;
+static size_t count_free_blocks(const TLSF::Allocator& allocator) {
+    size_t count = 0;
+    for (size_t fl = 0; fl < TLSF::FL_INDEX_COUNT; fl++) {
+        for (size_t sl = 0; sl < TLSF::SL_INDEX_COUNT; sl++) {
+            for (TLSF::Block* curr = allocator.blocks[fl][sl]; curr != nullptr; curr = curr->next_free) count++;
+        }
+    }
+    return count;
+}
 
-    FreeList::Allocator allocator;
-    assert(FreeList::init(allocator, BUFFER_SIZE));
+// hands every cached block back to the central heap first
+static size_t count_free_blocks(ConcurrentFreeList::Allocator& allocator) {
+    ConcurrentFreeList::flushThreadCache(allocator);
+    return count_free_blocks(allocator.central);
+}
+
+// allocator must be freshly initialized with buffer_size bytes
+template <typename Backend>
+void stl_test(Backend& allocator, size_t buffer_size) {
+    std::cout << "starting stl test ..." << std::endl;
 
     {
-        STLAllocator<char> stl_alloc(allocator);
-        MyMap map(stl_alloc);
+        STLAllocator<char, Backend> stl_alloc(allocator);
+        MyMap<Backend> map(stl_alloc);
         std::map<std::string, std::vector<std::string>> expected;
 
         // build a map with long keys/values so string buffers are allocated from the custom allocator
         for (int i = 0; i < 200; ++i) {
             std::string key_std = "key_" + std::to_string(i) + "_" + std::string(48, char('a' + (i % 26)));
-            MyString key = make_my_string(key_std, stl_alloc);
-            MyVec vec(stl_alloc);
+            MyString<Backend> key = make_my_string(key_std, stl_alloc);
+            MyVec<Backend> vec(stl_alloc);
             std::vector<std::string> expected_vec;
 
             int value_count = 1 + (i % 5);
@@ -81,7 +118,7 @@ void stl_test() {
         // mutate vectors for a subset of keys
         for (int i = 0; i < 200; i += 3) {
             std::string key_std = "key_" + std::to_string(i) + "_" + std::string(48, char('a' + (i % 26)));
-            MyString key = make_my_string(key_std, stl_alloc);
+            MyString<Backend> key = make_my_string(key_std, stl_alloc);
             auto it = map.find(key);
             assert(it != map.end());
 
@@ -93,7 +130,7 @@ void stl_test() {
         // erase a deterministic subset
         for (int i = 0; i < 200; i += 5) {
             std::string key_std = "key_" + std::to_string(i) + "_" + std::string(48, char('a' + (i % 26)));
-            MyString key = make_my_string(key_std, stl_alloc);
+            MyString<Backend> key = make_my_string(key_std, stl_alloc);
             size_t erased = map.erase(key);
             assert(erased == 1);
             expected.erase(key_std);
@@ -104,11 +141,11 @@ void stl_test() {
             std::string key_std = "key_" + std::to_string(i) + "_" + std::string(48, char('a' + (i % 26)));
             if (expected.find(key_std) == expected.end()) continue;
 
-            MyString key = make_my_string(key_std, stl_alloc);
+            MyString<Backend> key = make_my_string(key_std, stl_alloc);
             auto it = map.find(key);
             assert(it != map.end());
 
-            MyVec replacement(stl_alloc);
+            MyVec<Backend> replacement(stl_alloc);
             std::vector<std::string> replacement_expected;
             for (int j = 0; j < 4; ++j) {
                 std::string value_std = "replacement_" + std::to_string(i) + "_" + std::to_string(j) +
@@ -123,15 +160,15 @@ void stl_test() {
         assert_map_matches_expected(map, expected, stl_alloc);
 
         // copy and move semantics under the adaptor
-        MyMap copied(stl_alloc);
+        MyMap<Backend> copied(stl_alloc);
         copied = map;
         assert_map_matches_expected(copied, expected, stl_alloc);
 
-        MyMap moved(stl_alloc);
+        MyMap<Backend> moved(stl_alloc);
         moved = std::move(copied);
         assert_map_matches_expected(moved, expected, stl_alloc);
 
-        MyMap reassigned(stl_alloc);
+        MyMap<Backend> reassigned(stl_alloc);
         reassigned = moved;
         assert_map_matches_expected(reassigned, expected, stl_alloc);
 
@@ -139,13 +176,10 @@ void stl_test() {
     }
 
     // after all STL containers are destroyed, allocator should recover a large contiguous block
-    assert(allocator.free_list != nullptr);
-    assert(allocator.free_list->next == nullptr);
-    void* recovery = FreeList::alloc(allocator, BUFFER_SIZE / 2, MIN_ALIGNMENT);
+    assert(count_free_blocks(allocator) == 1);
+    void* recovery = alloc(allocator, buffer_size / 2, MIN_ALIGNMENT);
     assert(recovery != nullptr);
-    FreeList::free(allocator, recovery);
-
-    FreeList::destroy(allocator);
+    free(allocator, recovery);
 
     std::cout << "stl test passed!" << std::endl;
     std::cout << "-------------------" << std::endl;
@@ -154,16 +188,16 @@ void stl_test() {
 
 
 
-void stress_test() {
+// allocator must be freshly initialized with 10 KiB
+template <typename Backend>
+void stress_test(Backend& allocator) {
     struct Allocation {
         void* ptr;
         size_t size;
     };
 
     std::vector<Allocation> allocations;
-
-    FreeList::Allocator allocator;
-    assert(FreeList::init(allocator, 10 * 1024));
+    size_t failed = 0;
 
     std::srand(std::time(0));
 
@@ -175,10 +209,12 @@ void stress_test() {
 
         if (random < 7) { //alloc
             size_t random_size = std::rand() % 100 + 1;
-            void* ptr = FreeList::alloc(allocator, random_size, MIN_ALIGNMENT);
+            void* ptr = alloc(allocator, random_size, MIN_ALIGNMENT);
             if (ptr != nullptr) {
                 std::memset(ptr, 0xAA, random_size);
                 allocations.push_back({ptr, random_size});
+            } else {
+                failed++;
             }
 
 
@@ -193,7 +229,7 @@ void stress_test() {
                 assert(bytes[i] == 0xAA && "memory corrupted!");
             }
 
-            FreeList::free(allocator, alloc.ptr);
+            free(allocator, alloc.ptr);
 
             allocations.erase(allocations.begin() + random_index);
 
@@ -201,25 +237,509 @@ void stress_test() {
 
     }
 
+    // how badly the policy cut up the arena while it was still busy
+    if constexpr (std::is_same_v<Backend, FreeList::Allocator>) {
+        FreeList::Stats stats = FreeList::getStats(allocator);
+        std::cout << "policy " << (int) allocator.policy << ": fragmentation " << stats.fragmentation
+                  << ", free blocks " << stats.free_block_count << ", largest free block " << stats.largest_free_block
+                  << " of " << stats.free_bytes << " free, " << stats.cached_bytes << " cached, failed allocs " << failed << std::endl;
+    }
+
     // final cleanup
     std::cout << "freeing " << allocations.size() << " reminaing allocations..." << std::endl;
     for (auto& alloc : allocations) {
-        FreeList::free(allocator, alloc.ptr);
+        free(allocator, alloc.ptr);
     }
 
     std::cout << "final state should be one block" << std::endl;
 
-    FreeList::printFreeList(allocator);
+    if constexpr (std::is_same_v<Backend, FreeList::Allocator>) {
+        FreeList::printFreeList(allocator);
+    }
+    assert(count_free_blocks(allocator) == 1);
+
+}
+
+
+void pool_stl_test() {
+    std::cout << "starting pool stl test ..." << std::endl;
+
+    const size_t BUFFER_SIZE = 1024 * 1024;
+
+    FreeList::Allocator upstream;
+    assert(FreeList::init(upstream, BUFFER_SIZE));
+
+    PoolSet::Allocator pools;
+    assert(PoolSet::init(pools, upstream));
+
+    {
+        using PoolMap = std::map<int, int, std::less<int>, PoolSTLAllocator<std::pair<const int, int>>>;
+        using PoolList = std::list<int, PoolSTLAllocator<int>>;
+        using PoolVec = std::vector<int, PoolSTLAllocator<int>>;
+
+        PoolSTLAllocator<int> pool_alloc(pools);
+        PoolMap map(pool_alloc);
+        PoolList list(pool_alloc);
+        PoolVec vec(pool_alloc); // buffers outgrow the pools and go to the FreeList
+        std::map<int, int> expected;
+
+        for (int i = 0; i < 5000; i++) {
+            int key = (i * 7919) % 10007;
+            map[key] = i;
+            expected[key] = i;
+            list.push_back(i);
+            vec.push_back(i);
+        }
+
+        for (int i = 0; i < 5000; i += 3) {
+            int key = (i * 7919) % 10007;
+            map.erase(key);
+            expected.erase(key);
+        }
+        list.remove_if([](int v) { return v % 2 == 0; });
+
+        assert(map.size() == expected.size());
+        assert(std::equal(map.begin(), map.end(), expected.begin()));
+        assert(list.size() == 2500);
+        for (int i = 0; i < 5000; i++) assert(vec[i] == i);
+
+        PoolMap copied(pool_alloc);
+        copied = map;
+        assert(std::equal(copied.begin(), copied.end(), expected.begin()));
+
+        std::cout << "pool stl adaptor data integrity verified" << std::endl;
+    }
+
+    // every node went back to its pool
+    for (size_t i = 0; i < PoolSet::POOL_COUNT; i++) {
+        assert(Pool::getUsed(pools.pools[i]) == 0);
+    }
+
+    // and the chunks go back to the FreeList
+    PoolSet::destroy(pools);
+    assert(count_free_blocks(upstream) == 1);
+
+    FreeList::destroy(upstream);
+
+    std::cout << "pool stl test passed!" << std::endl;
+    std::cout << "-------------------" << std::endl;
+}
+
+// one container type for every allocator, the resource is picked at runtime
+void pmr_workload(std::pmr::memory_resource& resource) {
+    std::pmr::map<std::pmr::string, std::pmr::vector<std::pmr::string>> map(&resource);
+
+    for (int i = 0; i < 200; i++) {
+        std::pmr::string key("key number " + std::to_string(i % 50) + " with enough text to skip SSO", &resource);
+        map[key].emplace_back("value " + std::to_string(i) + " also long enough to need the heap");
+    }
+
+    assert(map.size() == 50);
+    for (auto& [key, values] : map) {
+        assert(values.size() == 4);
+        assert(values.get_allocator().resource() == &resource);
+        for (auto& value : values) assert(value.get_allocator().resource() == &resource);
+    }
+}
+
+void pmr_test() {
+    std::cout << "starting pmr test ..." << std::endl;
+
+    const size_t BUFFER_SIZE = 1024 * 1024;
+
+    FreeList::Allocator freelist;
+    assert(FreeList::init(freelist, BUFFER_SIZE));
+    TLSF::Allocator tlsf;
+    assert(TLSF::init(tlsf, BUFFER_SIZE));
+    ConcurrentFreeList::Allocator concurrent;
+    assert(ConcurrentFreeList::init(concurrent, BUFFER_SIZE));
+    FreeList::Allocator pool_upstream;
+    assert(FreeList::init(pool_upstream, BUFFER_SIZE));
+    PoolSet::Allocator pools;
+    assert(PoolSet::init(pools, pool_upstream));
+
+    {
+        MemoryResource::FreeListResource freelist_resource(freelist);
+        MemoryResource::TLSFResource tlsf_resource(tlsf);
+        MemoryResource::ConcurrentFreeListResource concurrent_resource(concurrent);
+        MemoryResource::PoolSetResource pool_resource(pools);
+
+        std::pmr::memory_resource* resources[] = {&freelist_resource, &tlsf_resource, &concurrent_resource, &pool_resource};
+        for (std::pmr::memory_resource* resource : resources) pmr_workload(*resource);
+
+        // a small fast arena in front of the FreeList, whatever does not fit spills upstream
+        Linear::Allocator arena;
+        assert(Linear::init(arena, 4096));
+        MemoryResource::LinearResource arena_resource(arena, &freelist_resource);
+
+        pmr_workload(arena_resource);
+        assert(Linear::getAvailable(arena) < 64);
+
+        // an arena without upstream reports exhaustion like any pmr resource
+        Linear::reset(arena);
+        MemoryResource::LinearResource bare_resource(arena);
+        bool threw = false;
+        try {
+            void* ptr = bare_resource.allocate(8192, 8);
+            (void)ptr;
+        } catch (const std::bad_alloc&) {
+            threw = true;
+        }
+        assert(threw);
+
+        Linear::destroy(arena);
+
+        // map nodes come from the pool, string and vector buffers that outgrow a slot go upstream
+        Pool::Allocator pool;
+        assert(Pool::init(pool, 128, 1024));
+        MemoryResource::PoolResource node_resource(pool, &freelist_resource);
+        pmr_workload(node_resource);
+        assert(Pool::getUsed(pool) == 0);
+        Pool::destroy(pool);
+    }
+
+    // everything was handed back
+    assert(count_free_blocks(freelist) == 1);
+    assert(count_free_blocks(tlsf) == 1);
+    assert(count_free_blocks(concurrent) == 1);
+    for (size_t i = 0; i < PoolSet::POOL_COUNT; i++) {
+        assert(Pool::getUsed(pools.pools[i]) == 0);
+    }
+
+    PoolSet::destroy(pools);
+    FreeList::destroy(pool_upstream);
+    ConcurrentFreeList::destroy(concurrent);
+    TLSF::destroy(tlsf);
+    FreeList::destroy(freelist);
+
+    std::cout << "pmr test passed!" << std::endl;
+    std::cout << "-------------------" << std::endl;
+}
+
+void trace_test() {
+    std::cout << "starting trace test ..." << std::endl;
+
+    const size_t BUFFER_SIZE = 1024 * 1024;
+    const char* TRACE_PATH = "integration_test_trace.bin";
+
+    FreeList::Allocator allocator;
+    assert(FreeList::init(allocator, BUFFER_SIZE));
+
+    // record containers and raw calls through the shim, from two threads. the FreeList itself is
+    // not thread-safe, the recording serializes every call into it
+    Trace::Recorder recorder;
+    Trace::Recording<FreeList::Allocator> recording{&allocator, &recorder};
+
+    auto workload = [&](int seed) {
+        using Vec = std::vector<int, STLAllocator<int, Trace::Recording<FreeList::Allocator>>>;
+        for (int round = 0; round < 20; round++) {
+            Vec vec{STLAllocator<int, Trace::Recording<FreeList::Allocator>>(recording)};
+            for (int i = 0; i < 100; i++) vec.push_back(i * seed);
+
+            void* ptr = Trace::alloc(recording, 24, 64);
+            ptr = Trace::realloc(recording, ptr, 200);
+            Trace::free(recording, ptr);
+        }
+    };
+    std::thread other(workload, 2);
+    workload(1);
+    other.join();
+
+    assert(count_free_blocks(allocator) == 1);
+    assert(Trace::save(recorder, TRACE_PATH));
+
+    std::vector<Trace::Event> events;
+    assert(Trace::load(TRACE_PATH, events));
+    std::remove(TRACE_PATH);
+    assert(events.size() == recorder.events.size());
+
+    // clock order, both threads show up, every id is allocated before it is used and freed once.
+    // a block never leaves the thread that allocated it, so neither does its id, an event logged
+    // after another thread got the same address back would break that
+    std::vector<bool> allocated(recorder.next_id, false);
+    std::vector<bool> freed(recorder.next_id, false);
+    std::vector<uint16_t> owner(recorder.next_id);
+    bool threads_seen[2] = {false, false};
+    for (size_t i = 0; i < events.size(); i++) {
+        const Trace::Event& event = events[i];
+        assert(event.timestamp == i);
+        assert(event.thread < 2);
+        threads_seen[event.thread] = true;
+        if ((Trace::Op) event.op == Trace::Op::Alloc) {
+            allocated[event.id] = true;
+            owner[event.id] = event.thread;
+            continue;
+        }
+        assert(allocated[event.id] && !freed[event.id] && owner[event.id] == event.thread);
+        if ((Trace::Op) event.op == Trace::Op::Free) freed[event.id] = true;
+    }
+    assert(threads_seen[0] && threads_seen[1]);
+    assert(recorder.ids.empty() && std::find(freed.begin(), freed.end(), false) == freed.end());
+
+    // replays the same way on any backend, and a fully freed trace leaves no holes behind
+    Trace::ReplayResult on_freelist = Trace::replay(events, allocator, allocator.memory);
+    assert(on_freelist.ops == events.size() && on_freelist.failed == 0);
+    assert(on_freelist.peak_live > 0 && on_freelist.peak_footprint >= on_freelist.peak_live);
+    assert(count_free_blocks(allocator) == 1);
+
+    TLSF::Allocator tlsf;
+    assert(TLSF::init(tlsf, BUFFER_SIZE));
+    Trace::ReplayResult on_tlsf = Trace::replay(events, tlsf, tlsf.memory);
+    assert(on_tlsf.failed == 0 && on_tlsf.peak_live == on_freelist.peak_live);
+    assert(count_free_blocks(tlsf) == 1);
+    TLSF::destroy(tlsf);
+
+    Linear::Allocator linear;
+    assert(Linear::init(linear, BUFFER_SIZE));
+    Trace::ReplayResult on_linear = Trace::replay(events, linear, linear.memory);
+    assert(on_linear.failed == 0 && on_linear.peak_live == on_freelist.peak_live);
+    assert(on_linear.peak_footprint == Linear::getUsed(linear));
+    Linear::destroy(linear);
 
     FreeList::destroy(allocator);
 
+    std::cout << "trace test passed!" << std::endl;
+    std::cout << "-------------------" << std::endl;
 }
 
+void concurrent_stress_test(FreeList::FitPolicy policy) {
+    struct Allocation {
+        void* ptr;
+        size_t size;
+        uint8_t pattern;
+    };
+
+    const int THREAD_COUNT = 4;
+    const int ITERATIONS = 5000;
+
+    ConcurrentFreeList::Allocator allocator;
+    assert(ConcurrentFreeList::init(allocator, 1024 * 1024, policy));
+
+    // blocks handed from one thread to another, so they get freed by a thread that did not allocate them
+    std::mutex mailbox_lock;
+    std::vector<Allocation> mailbox;
+
+    auto check = [](const Allocation& alloc) {
+        uint8_t* bytes = (uint8_t*)alloc.ptr;
+        for (size_t i = 0; i < alloc.size; i++) {
+            assert(bytes[i] == alloc.pattern && "memory corrupted!");
+        }
+    };
+
+    std::cout << "starting concurrent stress test..." << std::endl;
+
+    auto worker = [&](int thread_index) {
+        std::minstd_rand rng(std::time(0) + thread_index);
+        std::vector<Allocation> allocations;
+
+        for (int i = 0; i < ITERATIONS; i++) {
+            int random = rng() % 10;
+
+            if (random < 6) { //alloc, mostly small enough for the thread caches
+                size_t random_size = (rng() % 8 == 0) ? rng() % 2048 + 1 : rng() % 200 + 1;
+                void* ptr = ConcurrentFreeList::alloc(allocator, random_size, MIN_ALIGNMENT);
+                if (ptr != nullptr) {
+                    uint8_t pattern = (uint8_t)(thread_index * 37 + i);
+                    std::memset(ptr, pattern, random_size);
+                    allocations.push_back({ptr, random_size, pattern});
+                }
+
+            } else if (random < 8) { // free
+                if (allocations.empty()) continue;
+                size_t random_index = rng() % allocations.size();
+                check(allocations[random_index]);
+                ConcurrentFreeList::free(allocator, allocations[random_index].ptr);
+                allocations.erase(allocations.begin() + random_index);
+
+            } else if (random < 9) { // hand one to another thread
+                if (allocations.empty()) continue;
+                size_t random_index = rng() % allocations.size();
+                std::lock_guard<std::mutex> guard(mailbox_lock);
+                mailbox.push_back(allocations[random_index]);
+                allocations.erase(allocations.begin() + random_index);
+
+            } else { // free one somebody else allocated
+                Allocation alloc;
+                {
+                    std::lock_guard<std::mutex> guard(mailbox_lock);
+                    if (mailbox.empty()) continue;
+                    alloc = mailbox.back();
+                    mailbox.pop_back();
+                }
+                check(alloc);
+                ConcurrentFreeList::free(allocator, alloc.ptr);
+            }
+        }
+
+        for (auto& alloc : allocations) {
+            check(alloc);
+            ConcurrentFreeList::free(allocator, alloc.ptr);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREAD_COUNT; t++) threads.emplace_back(worker, t);
+    for (auto& thread : threads) thread.join();
+
+    std::cout << "freeing " << mailbox.size() << " blocks left in the mailbox..." << std::endl;
+    for (auto& alloc : mailbox) {
+        check(alloc);
+        ConcurrentFreeList::free(allocator, alloc.ptr);
+    }
+
+    // exited threads gave their caches back, flushing ours must leave one block
+    std::cout << "final state should be one block" << std::endl;
+    assert(count_free_blocks(allocator) == 1);
+
+    ConcurrentFreeList::destroy(allocator);
+    std::cout << "concurrent stress test passed!" << std::endl;
+}
+
+// threads exit while the allocator is being destroyed: each exiting thread either flushes its
+// cache before destroy takes the caches over or finds it detached, never touches a dead heap
+void concurrent_destroy_test() {
+    const int THREAD_COUNT = 8;
+
+    for (int round = 0; round < 20; round++) {
+        ConcurrentFreeList::Allocator allocator;
+        assert(ConcurrentFreeList::init(allocator, 1024 * 1024, FreeList::FitPolicy::Segregated));
+
+        std::atomic<int> ready{0};
+        std::atomic<bool> go{false};
+        std::vector<std::thread> threads;
+        for (int t = 0; t < THREAD_COUNT; t++) {
+            threads.emplace_back([&]() {
+                // leave blocks in the cache for the exit to flush
+                void* blocks[16];
+                for (void*& block : blocks) block = ConcurrentFreeList::alloc(allocator, 48, 8);
+                for (void* block : blocks) ConcurrentFreeList::free(allocator, block);
+                ready++;
+                while (!go.load()) std::this_thread::yield();
+            });
+        }
+        while (ready.load() != THREAD_COUNT) std::this_thread::yield();
+
+        go.store(true);
+        ConcurrentFreeList::destroy(allocator);
+        for (auto& thread : threads) thread.join();
+    }
+    std::cout << "concurrent destroy test passed!" << std::endl;
+}
+
+// threads fill one arena at once, through the shared offset and their own sub-chunks.
+// every block is checked for overlap after the threads are done, then the arena is reset
+void concurrent_linear_test() {
+    struct Allocation {
+        uint8_t* ptr;
+        size_t size;
+    };
+
+    const int THREAD_COUNT = 4;
+    const int ITERATIONS = 5000;
+    const int ROUNDS = 3;
+
+    ConcurrentLinear::Allocator allocator;
+    assert(ConcurrentLinear::init(allocator, 16 * 1024 * 1024));
+
+    std::cout << "starting concurrent linear test..." << std::endl;
+
+    for (int round = 0; round < ROUNDS; round++) {
+        std::vector<Allocation> per_thread[THREAD_COUNT];
+
+        auto worker = [&](int thread_index) {
+            ConcurrentLinear::Participant participant(allocator);
+            ConcurrentLinear::LocalArena local;
+            ConcurrentLinear::attach(local, allocator, 4096);
+            std::minstd_rand rng(std::time(0) + thread_index);
+
+            for (int i = 0; i < ITERATIONS; i++) {
+                size_t size = (rng() % 16 == 0) ? rng() % 2048 + 1 : rng() % 100 + 1;
+                size_t alignment = (size_t)8 << (rng() % 4);
+                bool shared = rng() % 2 == 0;
+                uint8_t* ptr = (uint8_t*) (shared ? ConcurrentLinear::alloc(allocator, size, alignment) : ConcurrentLinear::alloc(local, size, alignment));
+                assert(ptr != nullptr && (uintptr_t) ptr % alignment == 0);
+                std::memset(ptr, thread_index + 1, size);
+                per_thread[thread_index].push_back({ptr, size});
+            }
+
+            // somebody is inside, so nobody may reset
+            assert(!ConcurrentLinear::reset(allocator));
+        };
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < THREAD_COUNT; t++) threads.emplace_back(worker, t);
+        for (auto& thread : threads) thread.join();
+
+        std::vector<Allocation> all;
+        for (int t = 0; t < THREAD_COUNT; t++) {
+            for (const Allocation& alloc : per_thread[t]) {
+                for (size_t i = 0; i < alloc.size; i++) assert(alloc.ptr[i] == t + 1 && "memory corrupted!");
+                all.push_back(alloc);
+            }
+        }
+        std::sort(all.begin(), all.end(), [](const Allocation& a, const Allocation& b) { return a.ptr < b.ptr; });
+        for (size_t i = 1; i < all.size(); i++) assert(all[i - 1].ptr + all[i - 1].size <= all[i].ptr && "blocks overlap");
+
+        assert(ConcurrentLinear::reset(allocator));
+        assert(ConcurrentLinear::getUsed(allocator) == 0);
+    }
+
+    ConcurrentLinear::destroy(allocator);
+    std::cout << "concurrent linear test passed!" << std::endl;
+}
 
 int main() {
 
-    stress_test();
-    stl_test();
+    const size_t STRESS_BUFFER_SIZE = 10 * 1024;
+    const size_t STL_BUFFER_SIZE = 1024 * 1024;
+
+    for (FreeList::FitPolicy policy : {FreeList::FitPolicy::FirstFit, FreeList::FitPolicy::Segregated,
+                                       FreeList::FitPolicy::BestFit, FreeList::FitPolicy::AddressOrderedBestFit})
+    for (bool compact : {false, true})
+    for (bool front_cache : {false, true}) {
+        FreeList::Options options;
+        options.policy = policy;
+        options.compact_headers = compact;
+        options.front_cache = front_cache;
+        FreeList::Allocator allocator;
+
+        assert(FreeList::init(allocator, STRESS_BUFFER_SIZE, options));
+        stress_test(allocator);
+        FreeList::destroy(allocator);
+
+        assert(FreeList::init(allocator, STL_BUFFER_SIZE, options));
+        stl_test(allocator, STL_BUFFER_SIZE);
+        FreeList::destroy(allocator);
+    }
+
+    {
+        TLSF::Allocator allocator;
+
+        assert(TLSF::init(allocator, STRESS_BUFFER_SIZE));
+        stress_test(allocator);
+        TLSF::destroy(allocator);
+
+        assert(TLSF::init(allocator, STL_BUFFER_SIZE));
+        stl_test(allocator, STL_BUFFER_SIZE);
+        TLSF::destroy(allocator);
+    }
+
+    pool_stl_test();
+    pmr_test();
+    trace_test();
+
+    for (FreeList::FitPolicy policy : {FreeList::FitPolicy::FirstFit, FreeList::FitPolicy::Segregated,
+                                       FreeList::FitPolicy::BestFit, FreeList::FitPolicy::AddressOrderedBestFit}) {
+        concurrent_stress_test(policy);
+
+        ConcurrentFreeList::Allocator allocator;
+        assert(ConcurrentFreeList::init(allocator, STL_BUFFER_SIZE, policy));
+        stl_test(allocator, STL_BUFFER_SIZE);
+        ConcurrentFreeList::destroy(allocator);
+    }
+
+    concurrent_destroy_test();
+    concurrent_linear_test();
 
     return 0;
 }
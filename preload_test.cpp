@@ -0,0 +1,140 @@
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <dlfcn.h>
+#include <iostream>
+#include <malloc.h>
+#include <csignal>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// run under LD_PRELOAD=./libcustomalloc.so (make test-preload), checks the malloc family
+// really resolves to the library and behaves like the system one
+
+void test_interposed() {
+    Dl_info info;
+    assert(dladdr(dlsym(RTLD_DEFAULT, "malloc"), &info) != 0);
+    assert(info.dli_fname != nullptr && std::strstr(info.dli_fname, "libcustomalloc") != nullptr);
+    assert(dladdr(dlsym(RTLD_DEFAULT, "pvalloc"), &info) != 0);
+    assert(info.dli_fname != nullptr && std::strstr(info.dli_fname, "libcustomalloc") != nullptr);
+}
+
+void test_malloc_family() {
+    void* small = std::malloc(24);
+    assert(small != nullptr && (uintptr_t)small % alignof(std::max_align_t) == 0);
+    assert(malloc_usable_size(small) >= 24);
+
+    int* zeroed = (int*) std::calloc(1000, sizeof(int));
+    for (int i = 0; i < 1000; i++) assert(zeroed[i] == 0);
+    volatile size_t too_many = SIZE_MAX / 2; // volatile so the compiler does not reject the overflow up front
+    assert(std::calloc(too_many, 4) == nullptr);
+
+    char* grown = (char*) std::malloc(16);
+    std::memcpy(grown, "0123456789abcdef", 16);
+    grown = (char*) std::realloc(grown, 100000);
+    assert(std::memcmp(grown, "0123456789abcdef", 16) == 0);
+
+    void* aligned = nullptr;
+    assert(posix_memalign(&aligned, 4096, 100) == 0 && (uintptr_t)aligned % 4096 == 0);
+    void* aligned64 = aligned_alloc(64, 128);
+    assert((uintptr_t)aligned64 % 64 == 0);
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    void* paged = pvalloc(page + 1);
+    assert((uintptr_t)paged % page == 0 && malloc_usable_size(paged) >= 2 * page);
+
+    // huge requests get their own mapping
+    size_t huge_size = 8 * 1024 * 1024;
+    char* huge = (char*) std::malloc(huge_size);
+    assert(huge != nullptr && malloc_usable_size(huge) >= huge_size);
+    huge[0] = 1;
+    huge[huge_size - 1] = 2;
+    huge = (char*) std::realloc(huge, 2 * huge_size);
+    assert(huge[0] == 1 && huge[huge_size - 1] == 2);
+
+    std::free(huge);
+    std::free(paged);
+    std::free(aligned64);
+    std::free(aligned);
+    std::free(grown);
+    std::free(zeroed);
+    std::free(small);
+    std::free(nullptr);
+}
+
+// more than one heap's worth, spread over threads that free each other's blocks
+void test_threads() {
+    const int THREADS = 4;
+    std::vector<std::vector<void*>> blocks(THREADS);
+    std::vector<std::thread> threads;
+
+    for (int t = 0; t < THREADS; t++) {
+        threads.emplace_back([t, &blocks]() {
+            for (int i = 0; i < 20000; i++) {
+                size_t size = 16 + (i * 37 + t) % 8000;
+                char* ptr = (char*) std::malloc(size);
+                assert(ptr != nullptr);
+                ptr[0] = (char) t;
+                ptr[size - 1] = (char) t;
+                if (i % 3 == 0) std::free(ptr);
+                else blocks[t].push_back(ptr);
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    threads.clear();
+
+    for (int t = 0; t < THREADS; t++) {
+        threads.emplace_back([t, &blocks]() {
+            for (void* ptr : blocks[(t + 1) % THREADS]) std::free(ptr);
+        });
+    }
+    for (auto& thread : threads) thread.join();
+}
+
+// a pointer that is neither in the heap nor a huge mapping has no magic word, free aborts
+void test_invalid_free() {
+    alignas(64) static uint8_t not_ours[128];
+    for (int call = 0; call < 3; call++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            void* volatile ptr = not_ours + 64; // volatile so the compiler cannot see where it points
+            if (call == 0) std::free(ptr);
+            if (call == 1) (void) malloc_usable_size(ptr);
+            if (call == 2 && std::realloc(ptr, 100) != nullptr) _exit(0);
+            _exit(0);
+        }
+        int status = 0;
+        waitpid(pid, &status, 0);
+        assert(WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT);
+    }
+}
+
+void test_fork() {
+    void* before = std::malloc(100);
+    pid_t pid = fork();
+    if (pid == 0) {
+        void* child = std::malloc(100);
+        std::free(child);
+        std::free(before);
+        _exit(child != nullptr ? 0 : 1);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    std::free(before);
+}
+
+int main() {
+    std::cout << "------preload tests-------" << std::endl;
+    test_interposed();
+    test_malloc_family();
+    test_threads();
+    test_invalid_free();
+    test_fork();
+    std::cout << "preload tests passed!" << std::endl;
+    return 0;
+}
@@ -0,0 +1,86 @@
+#include "ConcurrentFreeListAllocator.h"
+#include "FreeListAllocator.h"
+#include "LinearAllocator.h"
+#include "SystemMalloc.h"
+#include "TLSFAllocator.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+// replays a recorded trace (see Trace.h) against every allocator and prints one CSV row each.
+// usage: alloc_replay <trace> [arena bytes]
+// without an arena size every arena gets 4x the trace's peak live bytes (at least 1 MiB)
+
+namespace {
+
+void print(const char* backend, const Trace::ReplayResult& result) {
+    std::cout << backend << "," << result.ops << "," << result.failed << "," << result.seconds << ","
+              << (result.seconds > 0 ? result.ops / result.seconds : 0) << "," << result.peak_live << ","
+              << result.peak_footprint << "," << result.fragmentation << std::endl;
+}
+
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <trace> [arena bytes]" << std::endl;
+        return 1;
+    }
+
+    std::vector<Trace::Event> events;
+    if (!Trace::load(argv[1], events)) {
+        std::cerr << "could not read trace " << argv[1] << std::endl;
+        return 1;
+    }
+
+    std::cout << "backend,ops,failed,seconds,ops_per_s,peak_live,peak_footprint,fragmentation" << std::endl;
+
+    // malloc first, it also tells us how big the arenas need to be
+    SystemMalloc::Allocator system;
+    Trace::ReplayResult baseline = Trace::replay(events, system);
+    print("malloc", baseline);
+
+    size_t arena_size = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : std::max((size_t)1 << 20, 4 * baseline.peak_live);
+
+    for (FreeList::FitPolicy policy : {FreeList::FitPolicy::FirstFit, FreeList::FitPolicy::Segregated}) {
+        for (bool compact : {false, true}) {
+            FreeList::Options options;
+            options.policy = policy;
+            options.compact_headers = compact;
+
+            FreeList::Allocator allocator;
+            if (!FreeList::init(allocator, arena_size, options)) return 1;
+            const char* name = policy == FreeList::FitPolicy::FirstFit
+                ? (compact ? "freelist_firstfit_compact" : "freelist_firstfit")
+                : (compact ? "freelist_segregated_compact" : "freelist_segregated");
+            print(name, Trace::replay(events, allocator, allocator.memory));
+            FreeList::destroy(allocator);
+        }
+    }
+
+    {
+        TLSF::Allocator allocator;
+        if (!TLSF::init(allocator, arena_size)) return 1;
+        print("tlsf", Trace::replay(events, allocator, allocator.memory));
+        TLSF::destroy(allocator);
+    }
+
+    {
+        ConcurrentFreeList::Allocator allocator;
+        if (!ConcurrentFreeList::init(allocator, arena_size)) return 1;
+        print("concurrent_freelist", Trace::replay(events, allocator, allocator.central.memory));
+        ConcurrentFreeList::destroy(allocator);
+    }
+
+    // nothing is given back before the end, so this is how much a frame arena would need
+    {
+        Linear::Allocator allocator;
+        if (!Linear::init(allocator, arena_size)) return 1;
+        print("linear", Trace::replay(events, allocator, allocator.memory));
+        Linear::destroy(allocator);
+    }
+
+    return 0;
+}
@@ -2,15 +2,27 @@
 #include <iostream>
 
 struct AllocationHeader {
-    size_t block_size; // size requested by user
+    size_t block_size; // Linear: size requested by user, FreeList: physical size of the block + flag bits
     size_t padding;
 };
+// FreeList with Options::compact_headers only keeps the first word: size + flags in the low 32 bits,
+// padding in the high 32 bits
 
 struct Node {
+    size_t block_size; // total size, including node (shares its word with AllocationHeader::block_size)
     Node* next;
-    size_t block_size; // total size, including header
+    Node* prev;
 };
 
-const size_t MIN_ALLOC_SIZE = sizeof(Node);
-const size_t MIN_SPLIT_SIZE = sizeof(AllocationHeader) + MIN_ALLOC_SIZE; // make sure it fits everything
+const size_t MIN_BLOCK_SIZE = sizeof(Node) + sizeof(size_t); // free block: node + footer
+const size_t MIN_ALLOC_SIZE = MIN_BLOCK_SIZE - sizeof(AllocationHeader);
+const size_t MIN_SPLIT_SIZE = MIN_BLOCK_SIZE; // make sure it fits everything
 const size_t MIN_ALIGNMENT = alignof(Node);
+
+// ALLOC_STATS turns on the counters behind the getStats functions, without it they compile away.
+// the library and everything using it must agree on it, it changes the allocator structs
+#ifdef ALLOC_STATS
+#define ALLOC_STAT(statement) statement
+#else
+#define ALLOC_STAT(statement)
+#endif
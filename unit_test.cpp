@@ -1,9 +1,20 @@
+#include <algorithm>
 #include <cstdint>
 #include <iostream>
 #include <cassert>
+#include <sys/mman.h>
 #include <sys/types.h>
 #include <cstring>
+#include <map>
+#include <vector>
+#include "BasicArena.h"
+#include "BasicFreeList.h"
+#include "ConcurrentLinearAllocator.h"
 #include "FreeListAllocator.h"
+#include "LinearAllocator.h"
+#include "PoolAllocator.h"
+#include "STLAllocator.h"
+#include "TLSFAllocator.h"
 
 // helpers
 #define TEST(name) void name()
@@ -13,17 +24,32 @@
     std::cout << "[PASS] " << #name << std::endl << std::endl;
 
 
+// every test runs once per fit policy, with and without compact headers
+static FreeList::Options options;
+
 // helper to align a pointer
 uintptr_t align_forward(uintptr_t ptr, size_t alignment) {
     return (ptr + alignment - 1) & ~(alignment - 1);
 }
 
+// pages of [ptr, ptr + size) that are backed by physical memory right now
+size_t resident_pages(void* ptr, size_t size) {
+    uintptr_t start = align_forward((uintptr_t) ptr, Pages::page_size());
+    size_t pages = ((uintptr_t) ptr + size - start) / Pages::page_size();
+    std::vector<unsigned char> residency(pages);
+    assert(mincore((void*) start, pages * Pages::page_size(), residency.data()) == 0);
+
+    size_t resident = 0;
+    for (unsigned char page : residency) resident += page & 1;
+    return resident;
+}
+
 // --- tests ---
 TEST(test_basic) {
     const size_t SIZE = 1024;
 
     FreeList::Allocator allocator;
-    FreeList::init(allocator, SIZE);
+    FreeList::init(allocator, SIZE, options);
 
     void* p1 = FreeList::alloc(allocator, 100, 8);
     assert(p1 != nullptr);
@@ -45,7 +71,7 @@ TEST(test_basic) {
 TEST(test_alignment) {
     const size_t SIZE = 1024;
     FreeList::Allocator allocator;
-    FreeList::init(allocator, SIZE);
+    FreeList::init(allocator, SIZE, options);
 
     //standarad alignment
     void* p1 = FreeList::alloc(allocator, 10, 8);
@@ -68,7 +94,7 @@ TEST(test_coalescence) {
     //
     const size_t SIZE = 2048;
     FreeList::Allocator allocator;
-    FreeList::init(allocator, SIZE);
+    FreeList::init(allocator, SIZE, options);
 
     void* p1 = FreeList::alloc(allocator, 100, 8); // uses around 120 bytes (for header)
     void* p2 = FreeList::alloc(allocator, 100, 8);
@@ -94,7 +120,7 @@ TEST(test_realloc_growth) {
     const size_t SIZE = 1024;
 
     FreeList::Allocator allocator;
-    FreeList::init(allocator, SIZE);
+    FreeList::init(allocator, SIZE, options);
 
     // alloc small
     int* p = (int*) FreeList::alloc(allocator, sizeof(int) * 10, 8);
@@ -110,10 +136,45 @@ TEST(test_realloc_growth) {
 
 }
 
+TEST(test_realloc_in_place) {
+    const size_t SIZE = 2048;
+    FreeList::Allocator allocator;
+    FreeList::init(allocator, SIZE, options);
+
+    int* p = (int*) FreeList::alloc(allocator, sizeof(int) * 10, 8);
+    for (int i = 0; i < 10; i++) p[i] = i;
+
+    // the rest of the arena is free right after p, so it grows without moving
+    int* grown = (int*) FreeList::realloc(allocator, p, sizeof(int) * 100);
+    assert(grown == p);
+    for (int i = 0; i < 10; i++) assert(grown[i] == i);
+
+    // the leftover was split off again and is still usable
+    void* blocker = FreeList::alloc(allocator, 64, 8);
+    assert(blocker != nullptr);
+    assert((uint8_t*)blocker >= (uint8_t*)grown + sizeof(int) * 100);
+
+    // next block is used now
+    assert(!FreeList::try_expand(allocator, grown, sizeof(int) * 200));
+    assert(FreeList::try_expand(allocator, grown, sizeof(int) * 50)); // already big enough
+
+    int* moved = (int*) FreeList::realloc(allocator, grown, sizeof(int) * 200);
+    assert(moved != nullptr && moved != grown);
+    for (int i = 0; i < 10; i++) assert(moved[i] == i);
+
+    FreeList::free(allocator, moved);
+    FreeList::free(allocator, blocker);
+
+    void* all = FreeList::alloc(allocator, SIZE - 100, 8);
+    assert(all != nullptr);
+
+    FreeList::destroy(allocator);
+}
+
 TEST(test_realloc_shrink_alignment_safety) {
     const size_t SIZE = 1024;
     FreeList::Allocator allocator;
-    FreeList::init(allocator, SIZE);
+    FreeList::init(allocator, SIZE, options);
 
     // allocate block aligned to 8
     // total size should be approx 128 + overhead
@@ -139,15 +200,1332 @@ TEST(test_realloc_shrink_alignment_safety) {
 
 }
 
+TEST(test_boundary_tag_merge) {
+    // freeing a block between two free neighbours merges all three in place
+    const size_t SIZE = 2048;
+    FreeList::Allocator allocator;
+    FreeList::init(allocator, SIZE, options);
+
+    void* a = FreeList::alloc(allocator, 48, 8);
+    void* b = FreeList::alloc(allocator, 48, 8);
+    void* c = FreeList::alloc(allocator, 48, 8);
+    void* guard = FreeList::alloc(allocator, 48, 8); // keeps c away from the tail of the arena
+    assert(a && b && c && guard);
+
+    FreeList::free(allocator, a);
+    FreeList::free(allocator, c);
+    FreeList::free(allocator, b);
+
+    // a + b + c is one block again, starting where a started
+    size_t span = (uint8_t*)guard - (uint8_t*)a;
+    void* merged = FreeList::alloc(allocator, span - 16, 8);
+    assert(merged == a);
+
+    FreeList::free(allocator, merged);
+    FreeList::free(allocator, guard);
+    FreeList::destroy(allocator);
+}
+
+TEST(test_compact_headers) {
+    const size_t SIZE = 4096;
+    FreeList::Options compact;
+    compact.compact_headers = true;
+
+    FreeList::Allocator full_allocator, compact_allocator;
+    FreeList::init(full_allocator, SIZE);
+    FreeList::init(compact_allocator, SIZE, compact);
+    assert(!full_allocator.compact_headers && compact_allocator.compact_headers);
+
+    // 24 byte objects: 16 + 24 = 40 bytes each with full headers, 8 + 24 = 32 with compact ones
+    void* f1 = FreeList::alloc(full_allocator, 24, 8);
+    void* f2 = FreeList::alloc(full_allocator, 24, 8);
+    void* c1 = FreeList::alloc(compact_allocator, 24, 8);
+    void* c2 = FreeList::alloc(compact_allocator, 24, 8);
+    assert((uint8_t*)f2 - (uint8_t*)f1 == 40);
+    assert((uint8_t*)c2 - (uint8_t*)c1 == 32);
+    assert(FreeList::usableSize(compact_allocator, c1) == 24);
+
+    // padding survives the packing, and realloc keeps it when resizing
+    void* aligned = FreeList::alloc(compact_allocator, 200, 256);
+    assert((uintptr_t)aligned % 256 == 0);
+    std::memset(aligned, 0x5A, 200);
+    assert(FreeList::realloc(compact_allocator, aligned, 40) == aligned);
+    assert(FreeList::usableSize(compact_allocator, aligned) >= 40);
+    assert(FreeList::try_expand(compact_allocator, aligned, 1000));
+    assert(((uint8_t*)aligned)[39] == 0x5A);
+
+    FreeList::free(compact_allocator, aligned);
+    FreeList::free(compact_allocator, c1);
+    FreeList::free(compact_allocator, c2);
+    assert(FreeList::alloc(compact_allocator, SIZE - 100, 8) != nullptr);
+
+    FreeList::destroy(full_allocator);
+    FreeList::destroy(compact_allocator);
+}
+
+TEST(test_freelist_stats) {
+    const size_t SIZE = 4096;
+    FreeList::Allocator allocator;
+    FreeList::init(allocator, SIZE, options);
+
+    void* a = FreeList::alloc(allocator, 100, 8);
+    void* b = FreeList::alloc(allocator, 100, 8);
+    void* c = FreeList::alloc(allocator, 100, 8);
+    assert(FreeList::alloc(allocator, SIZE, 8) == nullptr);
+
+    // a hole in front of the tail of the arena
+    FreeList::free(allocator, b);
+    FreeList::Stats stats = FreeList::getStats(allocator);
+    assert(stats.free_block_count == 2);
+    assert(stats.largest_free_block < stats.free_bytes);
+    assert(stats.fragmentation > 0.0 && stats.fragmentation < 0.1);
+
+    size_t histogram_blocks = 0;
+    for (size_t count : stats.histogram) histogram_blocks += count;
+    assert(histogram_blocks == stats.free_block_count);
+
+#ifdef ALLOC_STATS
+    assert(stats.counters.alloc_count == 3 && stats.counters.failed_allocs == 1);
+    assert(stats.counters.free_count == 1);
+    assert(stats.counters.bytes_in_use == stats.counters.peak_bytes_in_use * 2 / 3);
+    assert(stats.avg_nodes_scanned > 0.0);
+
+    a = FreeList::realloc(allocator, a, 20);
+    assert(FreeList::getStats(allocator).counters.realloc_count == 1);
+    assert(FreeList::getStats(allocator).counters.bytes_in_use < stats.counters.bytes_in_use);
+#endif
+
+    FreeList::free(allocator, a);
+    FreeList::free(allocator, c);
+    stats = FreeList::getStats(allocator);
+    assert(stats.free_block_count == 1 && stats.fragmentation == 0.0);
+#ifdef ALLOC_STATS
+    assert(stats.counters.bytes_in_use == 0);
+#endif
+
+    FreeList::destroy(allocator);
+}
+
+TEST(test_freelist_mmap_trim) {
+    const size_t SIZE = 8 * 1024 * 1024;
+    const size_t BIG = 4 * 1024 * 1024;
+    FreeList::Options mmap_options = options;
+    mmap_options.mmap_backed = true;
+
+    FreeList::Allocator allocator;
+    assert(FreeList::init(allocator, SIZE, mmap_options));
+    assert(allocator.capacity % Pages::page_size() == 0);
+
+    // nothing is committed before it is touched
+    assert(resident_pages(allocator.memory, allocator.capacity) < 4);
+
+    // a spike, then a small block that stays
+    char* spike = (char*) FreeList::alloc(allocator, BIG, 8);
+    assert(spike != nullptr);
+    std::memset(spike, 1, BIG);
+    void* keep = FreeList::alloc(allocator, 64, 8);
+    assert(resident_pages(spike, BIG) >= BIG / Pages::page_size() - 1);
+
+    FreeList::free(allocator, spike);
+    assert(FreeList::trim(allocator, 1024 * 1024) >= BIG - 2 * Pages::page_size());
+    assert(resident_pages(spike, BIG) <= 2);
+
+    // still a normal free block, it comes back zeroed
+    char* again = (char*) FreeList::alloc(allocator, BIG, 8);
+    assert(again == spike && again[BIG / 2] == 0);
+    again[BIG / 2] = 2;
+    assert(FreeList::trim(allocator, BIG) == 0); // nothing that big is free now
+    FreeList::free(allocator, again);
+    FreeList::free(allocator, keep);
+    FreeList::destroy(allocator);
+
+    // malloc'd arenas are never trimmed
+    FreeList::Allocator heap_allocator;
+    assert(FreeList::init(heap_allocator, SIZE, options));
+    assert(FreeList::trim(heap_allocator, 0) == 0);
+    FreeList::destroy(heap_allocator);
+
+    // huge pages are best effort, both modes always get an arena
+    for (Pages::HugePages huge : {Pages::HugePages::Transparent, Pages::HugePages::Explicit}) {
+        mmap_options.huge_pages = huge;
+        assert(FreeList::init(allocator, SIZE, mmap_options));
+        assert(allocator.capacity % Pages::HUGE_PAGE_SIZE == 0);
+        void* p = FreeList::alloc(allocator, BIG, 64);
+        assert(p != nullptr);
+        std::memset(p, 3, BIG);
+        FreeList::free(allocator, p);
+        FreeList::destroy(allocator);
+    }
+}
+
+TEST(test_freelist_calloc) {
+    const size_t SIZE = 8 * 1024 * 1024;
+    const size_t BIG = 4 * 1024 * 1024;
+    FreeList::Options mmap_options = options;
+    mmap_options.mmap_backed = true;
+
+    auto all_zero = [](const char* p, size_t size) {
+        for (size_t i = 0; i < size; i++) if (p[i] != 0) return false;
+        return true;
+    };
+
+    FreeList::Allocator allocator;
+    assert(FreeList::init(allocator, SIZE, mmap_options));
+
+    // fresh memory is zero already, calloc must not commit it by clearing
+    char* big = (char*) FreeList::calloc(allocator, BIG / 16, 16);
+    assert(big != nullptr);
+    assert(resident_pages(big, BIG) <= 2);
+    assert(all_zero(big, BIG));
+
+    // recycled memory has to be cleared, small and big
+    std::memset(big, 5, BIG);
+    FreeList::free(allocator, big);
+    for (size_t size : {8, 24, 100, 300, 5000}) {
+        char* p = (char*) FreeList::calloc(allocator, 1, size);
+        assert(p != nullptr && all_zero(p, size));
+        std::memset(p, 6, size);
+        FreeList::free(allocator, p);
+        p = (char*) FreeList::calloc(allocator, size, 1, 64);
+        assert(p != nullptr && ((uintptr_t) p & 63) == 0 && all_zero(p, size));
+        FreeList::free(allocator, p);
+    }
+    big = (char*) FreeList::calloc(allocator, 1, BIG);
+    assert(big != nullptr && all_zero(big, BIG));
+    std::memset(big, 7, BIG);
+    void* keep = FreeList::alloc(allocator, 64, 8);
+    FreeList::free(allocator, big);
+
+    // trimmed pages read as zero again, the block skips the clear once more
+    assert(FreeList::trim(allocator, 1024 * 1024) > 0);
+    big = (char*) FreeList::calloc(allocator, 1, BIG);
+    assert(big != nullptr);
+    assert(resident_pages(big, BIG) <= 2);
+    assert(all_zero(big, BIG));
+
+    // count * size overflows
+    assert(FreeList::calloc(allocator, SIZE_MAX / 2, 3) == nullptr);
+
+    FreeList::free(allocator, big);
+    FreeList::free(allocator, keep);
+    FreeList::destroy(allocator);
+
+    // a malloc'd arena is never assumed zero
+    assert(FreeList::init(allocator, SIZE, options));
+    char* p = (char*) FreeList::alloc(allocator, 4096, 8);
+    std::memset(p, 8, 4096);
+    FreeList::free(allocator, p);
+    p = (char*) FreeList::calloc(allocator, 1, 4096);
+    assert(p != nullptr && all_zero(p, 4096));
+    FreeList::free(allocator, p);
+    FreeList::destroy(allocator);
+}
+
+TEST(test_freelist_realloc_move) {
+    const size_t SIZE = 64 * 1024 * 1024;
+    const size_t page = Pages::page_size();
+
+    auto fill = [](char* p, size_t size) {
+        for (size_t i = 0; i < size; i++) p[i] = (char) (i * 7 + i / 4096);
+    };
+    auto filled = [](const char* p, size_t size) {
+        for (size_t i = 0; i < size; i++) if (p[i] != (char) (i * 7 + i / 4096)) return false;
+        return true;
+    };
+
+    for (bool mmap_backed : {true, false}) {
+        FreeList::Options move_options = options;
+        move_options.mmap_backed = mmap_backed;
+        FreeList::Allocator allocator;
+        assert(FreeList::init(allocator, SIZE, move_options));
+
+        // page aligned and big, the pages move (mmap) or get streamed over (malloc)
+        const size_t OLD = 2 * 1024 * 1024 + 100;
+        char* p = (char*) FreeList::alloc(allocator, OLD, page);
+        assert(p != nullptr);
+        fill(p, OLD);
+        void* blocker = FreeList::alloc(allocator, 4096, 8); // no growing in place (and too big to be cached)
+        char* q = (char*) FreeList::realloc(allocator, p, 4 * 1024 * 1024);
+        assert(q != nullptr && q != p && filled(q, OLD));
+        if (mmap_backed) {
+            assert(((uintptr_t) q & (page - 1)) == 0);
+            assert(resident_pages(p + page, OLD - 2 * page) == 0); // moved away, not copied
+        }
+
+        // the old block is mapped memory again and as good as any other free block
+        char* r = (char*) FreeList::alloc(allocator, OLD, page);
+        assert(r == p);
+        fill(r, OLD);
+        assert(filled(r, OLD) && filled(q, OLD));
+        FreeList::free(allocator, r);
+        FreeList::free(allocator, blocker);
+        FreeList::free(allocator, q);
+
+        // unaligned, with a ragged tail, copied with memcpy and with streaming stores. the arena
+        // is one free block again, so the blocker lands right behind a
+        for (size_t old_size : {(size_t) 300 * 1024 + 13, (size_t) 9 * 1024 * 1024 + 40}) {
+            char* a = (char*) FreeList::alloc(allocator, old_size, 8);
+            assert(a != nullptr);
+            fill(a, old_size);
+            blocker = FreeList::alloc(allocator, 4096, 8);
+            char* b = (char*) FreeList::realloc(allocator, a, old_size * 2);
+            assert(b != nullptr && b != a && filled(b, old_size));
+            FreeList::free(allocator, b);
+            FreeList::free(allocator, blocker);
+        }
+        assert(FreeList::getStats(allocator).free_block_count == 1);
+
+        // everything was written by now, a big calloc gets its clear streamed too
+        const size_t CLEARED = 9 * 1024 * 1024 + 24;
+        char* z = (char*) FreeList::calloc(allocator, 1, CLEARED);
+        assert(z != nullptr);
+        for (size_t i = 0; i < CLEARED; i++) assert(z[i] == 0);
+        FreeList::free(allocator, z);
+        FreeList::destroy(allocator);
+    }
+}
+
+TEST(test_freelist_growth) {
+    const size_t SIZE = 4096;
+    FreeList::Options growth_options = options;
+    growth_options.growable = true;
+    growth_options.max_region_size = 64 * 1024;
+
+    FreeList::Allocator allocator;
+    assert(FreeList::init(allocator, SIZE, growth_options));
+
+    // far more than the arena holds, every region gets filled with a pattern
+    std::vector<uint8_t*> blocks;
+    for (int i = 0; i < 500; i++) {
+        uint8_t* p = (uint8_t*) FreeList::alloc(allocator, 100, 16);
+        assert(p != nullptr && (uintptr_t)p % 16 == 0);
+        assert(FreeList::owns(allocator, p));
+        std::memset(p, i & 0xFF, 100);
+        blocks.push_back(p);
+    }
+    FreeList::Stats stats = FreeList::getStats(allocator);
+    assert(stats.region_count > 2 && stats.reserved_bytes > 500 * 100);
+    assert(!FreeList::owns(allocator, &stats));
+
+    for (int i = 0; i < 500; i++) {
+        assert(blocks[i][0] == (i & 0xFF) && blocks[i][99] == (i & 0xFF));
+        FreeList::free(allocator, blocks[i]);
+    }
+
+    // regions are kept by default, one free block per region
+    assert(FreeList::getStats(allocator).region_count == stats.region_count);
+    assert(FreeList::getStats(allocator).free_block_count == stats.region_count);
+
+    // bigger than any region, gets one of its own
+    void* big = FreeList::alloc(allocator, 256 * 1024, 8);
+    assert(big != nullptr);
+    assert(FreeList::getStats(allocator).region_count == stats.region_count + 1);
+    FreeList::free(allocator, big);
+    FreeList::destroy(allocator);
+
+    // with release_empty_regions the grown regions go away as they empty out
+    growth_options.release_empty_regions = true;
+    assert(FreeList::init(allocator, SIZE, growth_options));
+    blocks.clear();
+    for (int i = 0; i < 500; i++) blocks.push_back((uint8_t*) FreeList::alloc(allocator, 100, 8));
+    assert(FreeList::getStats(allocator).region_count > 2);
+    for (uint8_t* p : blocks) FreeList::free(allocator, p);
+    stats = FreeList::getStats(allocator);
+    assert(stats.region_count == 1 && stats.free_block_count == 1 && stats.reserved_bytes == SIZE);
+
+    // not growable: fails like before
+    FreeList::destroy(allocator);
+    assert(FreeList::init(allocator, SIZE, options));
+    assert(FreeList::alloc(allocator, 2 * SIZE, 8) == nullptr);
+    FreeList::destroy(allocator);
+
+    // over caller memory, mmap_backed maps the regions (the preload heap needs growth without malloc)
+    static uint8_t buffer[SIZE];
+    growth_options.release_empty_regions = false;
+    growth_options.mmap_backed = true;
+    assert(FreeList::init(allocator, buffer, SIZE, growth_options));
+    char* grown = (char*) FreeList::calloc(allocator, 1, 2 * SIZE);
+    assert(grown != nullptr && FreeList::owns(allocator, grown));
+    assert(grown < (char*) buffer || grown >= (char*) buffer + SIZE);
+    for (size_t i = 0; i < 2 * SIZE; i++) assert(grown[i] == 0);
+    assert(FreeList::getStats(allocator).region_count == 2);
+    FreeList::free(allocator, grown);
+    FreeList::destroy(allocator);
+}
+
+// sizes that would wrap once the header, padding and rounding are added fail cleanly
+TEST(test_freelist_huge_sizes) {
+    FreeList::Allocator allocator;
+    FreeList::init(allocator, 4096, options);
+
+    assert(FreeList::alloc(allocator, SIZE_MAX, 8) == nullptr);
+    assert(FreeList::alloc(allocator, SIZE_MAX - 8, 8) == nullptr);
+    assert(FreeList::alloc(allocator, 16, (size_t)1 << 63) == nullptr);
+    assert(FreeList::calloc(allocator, 1, SIZE_MAX - 8) == nullptr);
+    void* batch[4];
+    assert(FreeList::alloc_batch(allocator, SIZE_MAX - 8, 8, batch, 4) == 0);
+
+    // realloc and try_expand leave the block alone
+    uint8_t* p = (uint8_t*) FreeList::alloc(allocator, 100, 8);
+    std::memset(p, 0x5a, 100);
+    size_t usable = FreeList::usableSize(allocator, p);
+    assert(FreeList::realloc(allocator, p, SIZE_MAX - 8) == nullptr);
+    assert(!FreeList::try_expand(allocator, p, SIZE_MAX - 8));
+    assert(FreeList::usableSize(allocator, p) == usable);
+    for (int i = 0; i < 100; i++) assert(p[i] == 0x5a);
+
+    FreeList::free(allocator, p);
+    assert(FreeList::getStats(allocator).free_block_count == 1);
+    FreeList::destroy(allocator);
+}
+
+// one region per block, so owns has hundreds of regions to search
+TEST(test_freelist_owns_regions) {
+    const size_t BLOCK = 8 * 1024;
+    const int COUNT = 600;
+    FreeList::Options growth_options = options;
+    growth_options.growable = true;
+    growth_options.max_region_size = 2 * BLOCK;
+    growth_options.release_empty_regions = true;
+
+    FreeList::Allocator allocator;
+    assert(FreeList::init(allocator, 4096, growth_options));
+
+    std::vector<uint8_t*> blocks;
+    for (int i = 0; i < COUNT; i++) blocks.push_back((uint8_t*) FreeList::alloc(allocator, BLOCK, 8));
+    assert(FreeList::getStats(allocator).region_count == COUNT + 1);
+    for (uint8_t* p : blocks) assert(p != nullptr && FreeList::owns(allocator, p) && FreeList::owns(allocator, p + BLOCK - 1));
+    assert(!FreeList::owns(allocator, &allocator) && !FreeList::owns(allocator, nullptr));
+
+    // every other region goes away, the rest are still found
+    for (int i = 0; i < COUNT; i += 2) FreeList::free(allocator, blocks[i]);
+    assert(FreeList::getStats(allocator).region_count == COUNT / 2 + 1);
+    for (int i = 0; i < COUNT; i++) assert(FreeList::owns(allocator, blocks[i] + 8) == (i % 2 == 1));
+
+    for (int i = 1; i < COUNT; i += 2) FreeList::free(allocator, blocks[i]);
+    for (uint8_t* p : blocks) assert(!FreeList::owns(allocator, p));
+    assert(FreeList::getStats(allocator).region_count == 1);
+    FreeList::destroy(allocator);
+}
+
+TEST(test_freelist_batch) {
+    const size_t SIZE = 64 * 1024;
+    const size_t N = 100;
+    FreeList::Allocator allocator;
+    FreeList::init(allocator, SIZE, options);
+
+    // a fresh arena hands out one run, back to back
+    void* ptrs[N];
+    assert(FreeList::alloc_batch(allocator, 48, 16, ptrs, N) == N);
+    for (size_t i = 0; i < N; i++) {
+        assert((uintptr_t)ptrs[i] % 16 == 0 && FreeList::usableSize(allocator, ptrs[i]) >= 48);
+        if (i > 0) assert(ptrs[i] > ptrs[i - 1]);
+        std::memset(ptrs[i], (int) i, 48);
+    }
+    assert(FreeList::getStats(allocator).free_block_count == 1);
+    for (size_t i = 0; i < N; i++) assert(((uint8_t*) ptrs[i])[47] == (uint8_t) i);
+
+    // any order, with holes in between, merges back into one block
+    std::reverse(ptrs, ptrs + N);
+    std::swap(ptrs[3], ptrs[70]);
+    void* single = FreeList::alloc(allocator, 48, 16); // right after the run
+    void* kept[2] = {ptrs[10], ptrs[11]}; // two neighbours in the middle
+    ptrs[10] = nullptr; // nullptrs are skipped
+    ptrs[11] = nullptr;
+    FreeList::free_batch(allocator, ptrs, N);
+    assert(FreeList::getStats(allocator).free_block_count == 3); // around kept, and the tail after single
+    FreeList::free_batch(allocator, kept, 2);
+    FreeList::free(allocator, single);
+    FreeList::Stats stats = FreeList::getStats(allocator);
+    assert(stats.free_block_count == 1);
+#ifdef ALLOC_STATS
+    assert(stats.counters.alloc_count == N + 1 && stats.counters.free_count == N + 1);
+    assert(stats.counters.bytes_in_use == 0);
+#endif
+
+    // holes first, then the rest of the arena, until it runs out
+    void* holes[10];
+    for (void*& hole : holes) hole = FreeList::alloc(allocator, 32, 8);
+    for (int i = 0; i < 10; i += 2) FreeList::free(allocator, holes[i]);
+    std::vector<void*> many(SIZE / 32);
+    size_t count = FreeList::alloc_batch(allocator, 32, 8, many.data(), many.size());
+    assert(count > SIZE / 64 && count < many.size());
+    for (size_t i = 0; i < count; i++) std::memset(many[i], 0xAB, 32);
+    for (int i = 1; i < 10; i += 2) many[count++] = holes[i];
+    FreeList::free_batch(allocator, many.data(), count);
+    assert(FreeList::getStats(allocator).free_block_count == 1);
+    FreeList::destroy(allocator);
+
+    // a growable arena maps one region for the shortfall
+    FreeList::Options growth_options = options;
+    growth_options.growable = true;
+    FreeList::init(allocator, 4096, growth_options);
+    count = FreeList::alloc_batch(allocator, 64, 8, many.data(), 1000);
+    assert(count == 1000 && FreeList::getStats(allocator).region_count == 2);
+    FreeList::free_batch(allocator, many.data(), count);
+    FreeList::destroy(allocator);
+}
+
+TEST(test_freelist_sized_free) {
+    const size_t SIZE = 4096;
+    FreeList::Allocator allocator;
+    FreeList::init(allocator, SIZE, options);
+
+    void* a = FreeList::alloc(allocator, 24, 8);
+    void* b = FreeList::alloc(allocator, 100, 1);
+    void* c = FreeList::alloc(allocator, 40, 64); // padded, goes through free
+    void* d = FreeList::alloc(allocator, 7, 4);
+
+    FreeList::free_sized(allocator, b, 100, 1);
+    FreeList::free_sized(allocator, c, 40, 64);
+    FreeList::free_sized(allocator, nullptr, 0, 8);
+    assert(FreeList::getStats(allocator).free_block_count == 2); // b + c merged, and the tail
+
+    FreeList::free_sized(allocator, a, 24, 8);
+    FreeList::free_sized(allocator, d, 7, 4);
+    FreeList::Stats stats = FreeList::getStats(allocator);
+    assert(stats.free_block_count == 1);
+#ifdef ALLOC_STATS
+    assert(stats.counters.free_count == 4 && stats.counters.bytes_in_use == 0);
+#endif
+
+    // containers take the sized path through STLAllocator
+    static_assert(has_free_sized<FreeList::Allocator>::value, "FreeList has a sized free");
+    static_assert(!has_free_sized<TLSF::Allocator>::value, "TLSF does not");
+    {
+        std::vector<int, STLAllocator<int>> vec{STLAllocator<int>(allocator)};
+        for (int i = 0; i < 200; i++) vec.push_back(i);
+        for (int i = 0; i < 200; i++) assert(vec[i] == i);
+    }
+    assert(FreeList::getStats(allocator).free_block_count == 1);
+    FreeList::destroy(allocator);
+
+    // with size classes small requests get header-less slots, packed back to back
+    FreeList::Options sized = options;
+    sized.size_classes = true;
+    FreeList::init(allocator, 256 * 1024, sized);
+    uint8_t* s1 = (uint8_t*) FreeList::alloc_sized(allocator, 24, 8);
+    uint8_t* s2 = (uint8_t*) FreeList::alloc_sized(allocator, 20, 4);
+    uint8_t* s3 = (uint8_t*) FreeList::alloc_sized(allocator, 1, 1);
+    assert(s2 == s1 + 24 && s3 != nullptr);
+    assert(FreeList::getStats(allocator).size_class_bytes == 2 * FreeList::SIZE_CLASS_CHUNK);
+    std::memset(s1, 0xab, 24);
+    std::memset(s2, 0xcd, 24);
+    FreeList::free_sized(allocator, s1, 24, 8);
+    assert(FreeList::alloc_sized(allocator, 17, 8) == s1); // same class, last freed first
+    FreeList::free_sized(allocator, s1, 24, 8);
+    FreeList::free_sized(allocator, s2, 24, 8);
+    FreeList::free_sized(allocator, s3, 1, 1);
+
+    // too big or too aligned for a slot: a normal block, free works on it as well
+    void* large = FreeList::alloc_sized(allocator, FreeList::SIZE_CLASS_LIMIT + 1, 8);
+    void* aligned = FreeList::alloc_sized(allocator, 24, 64);
+    assert(((uintptr_t) aligned & 63) == 0);
+    FreeList::free_sized(allocator, large, FreeList::SIZE_CLASS_LIMIT + 1, 8);
+    FreeList::free(allocator, aligned);
+
+    // container nodes and small vectors come from the slots, the chunks stay with the classes
+    {
+        std::map<int, int, std::less<int>, STLAllocator<std::pair<const int, int>>> map{STLAllocator<std::pair<const int, int>>(allocator)};
+        std::vector<int, STLAllocator<int>> vec{STLAllocator<int>(allocator)};
+        for (int i = 0; i < 1000; i++) map[i] = i;
+        for (int i = 0; i < 1000; i++) vec.push_back(i);
+        for (int i = 0; i < 1000; i++) assert(map[i] == i && vec[i] == i);
+    }
+    assert(FreeList::getStats(allocator).size_class_bytes > 2 * FreeList::SIZE_CLASS_CHUNK);
+    FreeList::destroy(allocator);
+}
+
+TEST(test_freelist_front_cache) {
+    const size_t SIZE = 64 * 1024;
+    FreeList::Options cached = options;
+    cached.front_cache = true;
+    cached.front_cache_bytes = 2048;
+    FreeList::Allocator allocator;
+    FreeList::init(allocator, SIZE, cached);
+
+    void* a = FreeList::alloc(allocator, 40, 8);
+    void* fence = FreeList::alloc(allocator, 40, 8);
+    FreeList::free(allocator, a);
+    FreeList::Stats stats = FreeList::getStats(allocator);
+    assert(stats.cached_bytes > 0 && stats.free_block_count == 1); // a sits in the cache, not the free structures
+
+    // the same size comes straight back, a slightly smaller one rounds to the same block
+    assert(FreeList::alloc(allocator, 40, 8) == a);
+    FreeList::free_sized(allocator, a, 40, 8);
+    assert(FreeList::alloc(allocator, 36, 4) == a);
+    assert(FreeList::getStats(allocator).cached_bytes == 0);
+
+    // big blocks skip the cache, and so do padded ones (a plain alloc could not reuse them)
+    void* big = FreeList::alloc(allocator, 1024, 8);
+    FreeList::free(allocator, big);
+    assert(FreeList::getStats(allocator).cached_bytes == 0);
+    uint8_t* padded = (uint8_t*) FreeList::alloc(allocator, 40, 128);
+    // its block starts where fence's ends (40 bytes after fence in both header modes)
+    bool has_padding = padded != (uint8_t*) fence + 40 + allocator.header_size;
+    FreeList::free(allocator, padded);
+    assert((FreeList::getStats(allocator).cached_bytes == 0) == has_padding);
+    FreeList::flushFrontCache(allocator);
+
+    // more than front_cache_bytes: everything goes back and coalesces
+    std::vector<void*> blocks;
+    for (int i = 0; i < 64; i++) blocks.push_back(FreeList::alloc(allocator, 48, 8));
+    for (void* p : blocks) {
+        FreeList::free(allocator, p);
+        assert(FreeList::getStats(allocator).cached_bytes <= cached.front_cache_bytes);
+    }
+
+    FreeList::free(allocator, a);
+    FreeList::free(allocator, fence);
+    FreeList::flushFrontCache(allocator);
+    stats = FreeList::getStats(allocator);
+    assert(stats.cached_bytes == 0 && stats.free_block_count == 1);
+#ifdef ALLOC_STATS
+    assert(stats.counters.bytes_in_use == 0);
+#endif
+
+    FreeList::destroy(allocator);
+}
+
+TEST(test_segregated_reuses_hole) {
+    // churn the heap so a first-fit walk would have to skip many small holes
+    const size_t SIZE = 64 * 1024;
+    FreeList::Allocator allocator;
+    FreeList::init(allocator, SIZE, FreeList::FitPolicy::Segregated);
+
+    void* blocks[256];
+    for (int i = 0; i < 256; i++) {
+        blocks[i] = FreeList::alloc(allocator, 64, 8);
+        assert(blocks[i] != nullptr);
+    }
+    for (int i = 0; i < 256; i += 2) FreeList::free(allocator, blocks[i]);
+
+    // holes are in a small bin, the tail of the arena in a large one
+    assert(allocator.bin_bitmap != 0);
+    assert(__builtin_popcountll(allocator.bin_bitmap) == 2);
+
+    // a large request skips the small bins entirely
+    void* big = FreeList::alloc(allocator, 4096, 8);
+    assert(big != nullptr);
+    assert((uint8_t*)big > (uint8_t*)blocks[255]);
+
+    // a hole-sized request is served from a hole
+    void* p = FreeList::alloc(allocator, 64, 8);
+    assert(p != nullptr && (uint8_t*)p < (uint8_t*)blocks[255]);
+
+    FreeList::free(allocator, p);
+    FreeList::free(allocator, big);
+    for (int i = 1; i < 256; i += 2) FreeList::free(allocator, blocks[i]);
+
+    // everything merged back into one block
+    assert(__builtin_popcountll(allocator.bin_bitmap) == 1);
+    void* all = FreeList::alloc(allocator, SIZE - 1024, 8);
+    assert(all != nullptr);
+
+    FreeList::destroy(allocator);
+}
+
+TEST(test_segregated_constant_time) {
+    const size_t SIZE = 256 * 1024;
+    FreeList::Allocator allocator;
+    FreeList::init(allocator, SIZE, FreeList::FitPolicy::Segregated);
+
+    // 100 holes of ~600 bytes share the [512, 1024) bin, none holds 900
+    void* holes[100];
+    void* fences[100];
+    for (int i = 0; i < 100; i++) {
+        holes[i] = FreeList::alloc(allocator, 600, 8);
+        fences[i] = FreeList::alloc(allocator, 16, 8);
+    }
+    for (void* hole : holes) FreeList::free(allocator, hole);
+
+    // the tail's bin is above, its head is taken without walking the holes
+#ifdef ALLOC_STATS
+    size_t scanned = allocator.counters.nodes_scanned;
+#endif
+    void* p = FreeList::alloc(allocator, 900, 8);
+    assert(p > fences[99]);
+#ifdef ALLOC_STATS
+    assert(allocator.counters.nodes_scanned == scanned + 1);
+#endif
+
+    // a hole sized request still lands in a hole
+    void* q = FreeList::alloc(allocator, 600, 8);
+    assert(q < fences[99]);
+
+    FreeList::free(allocator, q);
+    FreeList::free(allocator, p);
+    for (void* fence : fences) FreeList::free(allocator, fence);
+    FreeList::destroy(allocator);
+
+    // when only the request's own bin is left its blocks are still checked
+    FreeList::init(allocator, 1024, FreeList::FitPolicy::Segregated);
+    p = FreeList::alloc(allocator, 900, 8);
+    assert(p != nullptr);
+    FreeList::free(allocator, p);
+    FreeList::destroy(allocator);
+}
+
+TEST(test_best_fit_policies) {
+    const size_t SIZE = 64 * 1024;
+
+    for (FreeList::FitPolicy policy : {FreeList::FitPolicy::BestFit, FreeList::FitPolicy::AddressOrderedBestFit}) {
+        FreeList::Allocator allocator;
+        FreeList::init(allocator, SIZE, policy);
+
+        // holes of 2048, 512, 512 and 1024 bytes, kept apart by small used blocks
+        size_t hole_sizes[] = {2048, 512, 512, 1024};
+        void* holes[4];
+        void* fences[4];
+        for (int i = 0; i < 4; i++) {
+            holes[i] = FreeList::alloc(allocator, hole_sizes[i], 8);
+            fences[i] = FreeList::alloc(allocator, 16, 8);
+            assert(holes[i] != nullptr && fences[i] != nullptr);
+        }
+        for (int i = 3; i >= 0; i--) FreeList::free(allocator, holes[i]);
+        assert(FreeList::getStats(allocator).free_block_count == 5); // the holes and the tail
+
+        // first fit would cut into the 2048 hole, best fit takes a 512 one. address ordering
+        // decides between the two, plain best fit may take either
+        void* p = FreeList::alloc(allocator, 400, 8);
+        if (policy == FreeList::FitPolicy::AddressOrderedBestFit) assert(p == holes[1]);
+        else assert(p == holes[1] || p == holes[2]);
+
+        void* q = FreeList::alloc(allocator, 900, 8);
+        assert(q == holes[3]);
+
+        // bigger than every hole, comes from the tail
+        void* big = FreeList::alloc(allocator, 4096, 8);
+        assert((uint8_t*) big > (uint8_t*) fences[3]);
+
+        // a stricter alignment still finds a hole that can hold it
+        void* aligned = FreeList::alloc(allocator, 300, 256);
+        assert(aligned != nullptr && (uintptr_t) aligned % 256 == 0);
+
+        FreeList::free(allocator, aligned);
+        FreeList::free(allocator, big);
+        FreeList::free(allocator, q);
+        FreeList::free(allocator, p);
+        for (void* fence : fences) FreeList::free(allocator, fence);
+        assert(FreeList::getStats(allocator).free_block_count == 1);
+
+        FreeList::destroy(allocator);
+    }
+}
+
+TEST(test_best_fit_trim) {
+    const size_t SIZE = 16 * 1024 * 1024;
+    const size_t HOLE = 256 * 1024;
+    const size_t page = Pages::page_size();
+
+    for (FreeList::FitPolicy policy : {FreeList::FitPolicy::BestFit, FreeList::FitPolicy::AddressOrderedBestFit}) {
+        FreeList::Options tree_options;
+        tree_options.policy = policy;
+        tree_options.mmap_backed = true;
+        FreeList::Allocator allocator;
+        assert(FreeList::init(allocator, SIZE, tree_options));
+
+        // several big holes of different sizes, so the tree nodes have children and parents. each
+        // hole's block starts 32 bytes before a page boundary, which puts its tree links on the
+        // first page trim is allowed to drop when it only keeps the Node part
+        void* holes[6];
+        void* fences[6];
+        uint8_t* first = (uint8_t*) FreeList::alloc(allocator, 16, 8);
+        uint8_t* next = first + FreeList::usableSize(allocator, first); // where the next block starts
+        for (int i = 0; i < 6; i++) {
+            size_t gap = (page - 32 - (uintptr_t) next % page) % page;
+            if (gap < 32) gap += page;
+            fences[i] = FreeList::alloc(allocator, gap - sizeof(AllocationHeader), 8);
+            holes[i] = FreeList::alloc(allocator, HOLE * (1 + i % 3), 8);
+            assert(fences[i] != nullptr && holes[i] != nullptr);
+            assert(((uintptr_t) holes[i] - sizeof(AllocationHeader)) % page == page - 32);
+            std::memset(holes[i], 1, HOLE * (1 + i % 3));
+            next = (uint8_t*) holes[i] + FreeList::usableSize(allocator, holes[i]);
+        }
+        void* last = FreeList::alloc(allocator, 16, 8); // keeps the last hole apart from the tail
+
+        for (void* hole : holes) FreeList::free(allocator, hole);
+        assert(FreeList::getStats(allocator).free_block_count == 7); // the holes and the tail
+
+        assert(FreeList::trim(allocator, 64 * 1024) > 0);
+        assert(FreeList::getStats(allocator).free_block_count == 7);
+
+        // every hole can still be found and handed out
+        for (int i = 0; i < 6; i++) {
+            holes[i] = FreeList::alloc(allocator, HOLE * (1 + i % 3), 8);
+            assert(holes[i] != nullptr && (uint8_t*) holes[i] < (uint8_t*) last);
+            std::memset(holes[i], 2, HOLE * (1 + i % 3));
+        }
+        assert(FreeList::getStats(allocator).free_block_count == 1);
+
+        for (void* hole : holes) FreeList::free(allocator, hole);
+        for (void* fence : fences) FreeList::free(allocator, fence);
+        FreeList::free(allocator, first);
+        FreeList::free(allocator, last);
+        assert(FreeList::getStats(allocator).free_block_count == 1);
+        FreeList::destroy(allocator);
+    }
+}
+
+// the same checks for every BasicFreeList instantiation, capacity is the arena size
+template <typename Policy>
+void basic_freelist_checks(BasicFreeList<Policy>& heap, size_t capacity) {
+    const size_t ALIGNMENT = Policy::alignment;
+
+    std::vector<uint8_t*> blocks;
+    for (size_t i = 0; i < 64; i++) {
+        size_t size = 1 + (i * 37) % 200;
+        uint8_t* p = (uint8_t*) alloc(heap, size);
+        assert(p != nullptr && (uintptr_t)p % ALIGNMENT == 0);
+        assert(usableSize(heap, p) >= size);
+        std::memset(p, (int) i, size);
+        blocks.push_back(p);
+    }
+    for (size_t i = 0; i < blocks.size(); i += 2) free(heap, blocks[i]);
+
+    // stricter than the policy: the gap in front is split off
+    uint8_t* aligned = (uint8_t*) alloc(heap, 100, 256);
+    assert(aligned != nullptr && (uintptr_t)aligned % 256 == 0);
+
+    // realloc keeps the data
+    uint8_t* grown = (uint8_t*) realloc(heap, blocks[1], 1000);
+    assert(grown != nullptr && grown[0] == 1 && (uintptr_t)grown % ALIGNMENT == 0);
+    blocks[1] = grown;
+
+    // sizes that wrap when rounded to a block are refused, the block keeps its size
+    size_t usable = usableSize(heap, grown);
+    assert(alloc(heap, SIZE_MAX - 8) == nullptr);
+    assert(realloc(heap, grown, SIZE_MAX - 8) == nullptr);
+    assert(usableSize(heap, grown) == usable && grown[0] == 1);
+
+    for (size_t i = 1; i < blocks.size(); i += 2) {
+        assert(blocks[i][0] == (uint8_t) i);
+        free(heap, blocks[i]);
+    }
+    free(heap, aligned);
+
+    // everything coalesced back into one block
+    assert(alloc(heap, capacity, ALIGNMENT) == nullptr);
+    void* all = alloc(heap, capacity - 4 * BasicFreeList<Policy>::MIN_BLOCK - 2 * ALIGNMENT);
+    assert(all != nullptr);
+    free(heap, all);
+}
+
+TEST(test_basic_freelist) {
+    // in static storage, no malloc anywhere
+    static BasicFreeList<FreeListPolicy<FreeList::FitPolicy::Segregated, 16, 64 * 1024>> static_heap;
+    assert(init(static_heap));
+    basic_freelist_checks(static_heap, 64 * 1024);
+
+    // on the stack
+    BasicFreeList<FreeListPolicy<FreeList::FitPolicy::FirstFit, 8, 16 * 1024>> stack_heap;
+    assert(init(stack_heap));
+    basic_freelist_checks(stack_heap, 16 * 1024);
+
+    // from malloc, with cache line sized blocks
+    BasicFreeList<FreeListPolicy<FreeList::FitPolicy::FirstFit, 64>> malloc_heap;
+    assert(init(malloc_heap, 32 * 1024));
+    basic_freelist_checks(malloc_heap, 32 * 1024);
+
+    // works behind the STL adaptor like the runtime allocators
+    {
+        using Heap = BasicFreeList<FreeListPolicy<FreeList::FitPolicy::FirstFit, 64>>;
+        std::vector<int, STLAllocator<int, Heap>> vec{STLAllocator<int, Heap>(malloc_heap)};
+        for (int i = 0; i < 1000; i++) vec.push_back(i);
+        for (int i = 0; i < 1000; i++) assert(vec[i] == i);
+    }
+    destroy(malloc_heap);
+}
+
+TEST(test_basic_arena) {
+    BasicArena<1024, 16> arena;
+
+    void* a = alloc(arena, 10);
+    void* b = alloc(arena, 1);
+    assert((uint8_t*)b - (uint8_t*)a == 16);
+    assert(getUsed(arena) == 32 && getAvailable(arena) == 1024 - 32);
+
+    size_t marker = getMarker(arena);
+    void* c = alloc(arena, 8, 128);
+    assert(c != nullptr && (uintptr_t)c % 128 == 0);
+    rollbackTo(arena, marker);
+    assert(getUsed(arena) == 32);
+
+    assert(alloc(arena, 1024) == nullptr);
+    assert(alloc(arena, SIZE_MAX - 4) == nullptr && getUsed(arena) == 32); // would round to 0
+    assert(alloc(arena, 1024 - 32) != nullptr);
+    assert(getAvailable(arena) == 0 && alloc(arena, 1) == nullptr);
+
+    reset(arena);
+    assert(alloc(arena, 1024) == a);
+}
+
+TEST(test_tlsf_basic) {
+    const size_t SIZE = 1024;
+
+    TLSF::Allocator allocator;
+    assert(TLSF::init(allocator, SIZE));
+
+    void* p1 = TLSF::alloc(allocator, 100, 8);
+    void* p2 = TLSF::alloc(allocator, 100, 8);
+    assert(p1 != nullptr && p2 != nullptr && p1 != p2);
+    assert((uint8_t*)p2 >= (uint8_t*)p1 + 100 || (uint8_t*)p1 >= (uint8_t*)p2 + 100);
+
+    TLSF::free(allocator, p1);
+    TLSF::free(allocator, p2);
+
+    // both blocks merged back, the whole pool is available again
+    void* p3 = TLSF::alloc(allocator, SIZE - 100, 8);
+    assert(p3 != nullptr);
+
+    // nothing left
+    assert(TLSF::alloc(allocator, 100, 8) == nullptr);
+
+    TLSF::free(allocator, p3);
+    TLSF::destroy(allocator);
+}
+
+TEST(test_tlsf_alignment) {
+    const size_t SIZE = 4096;
+    TLSF::Allocator allocator;
+    assert(TLSF::init(allocator, SIZE));
+
+    void* p1 = TLSF::alloc(allocator, 10, 8);
+    assert((uintptr_t)p1 % 8 == 0);
+
+    void* p2 = TLSF::alloc(allocator, 10, 64);
+    assert((uintptr_t)p2 % 64 == 0);
+
+    void* p3 = TLSF::alloc(allocator, 200, 256);
+    assert((uintptr_t)p3 % 256 == 0);
+
+    std::memset(p1, 0x11, 10);
+    std::memset(p2, 0x22, 10);
+    std::memset(p3, 0x33, 200);
+    assert(((uint8_t*)p1)[9] == 0x11 && ((uint8_t*)p2)[9] == 0x22);
+
+    TLSF::free(allocator, p2);
+    TLSF::free(allocator, p1);
+    TLSF::free(allocator, p3);
+
+    // the leading gaps were given back too
+    void* all = TLSF::alloc(allocator, SIZE - 200, 8);
+    assert(all != nullptr);
+
+    TLSF::free(allocator, all);
+    TLSF::destroy(allocator);
+}
+
+TEST(test_tlsf_realloc) {
+    const size_t SIZE = 2048;
+    TLSF::Allocator allocator;
+    assert(TLSF::init(allocator, SIZE));
+
+    int* p = (int*) TLSF::alloc(allocator, sizeof(int) * 10, 8);
+    for (int i = 0; i < 10; i++) p[i] = i;
+
+    // next block is free, grows in place
+    int* grown = (int*) TLSF::realloc(allocator, p, sizeof(int) * 100);
+    assert(grown == p);
+    for (int i = 0; i < 10; i++) assert(grown[i] == i);
+
+    // next block is used, has to move
+    void* blocker = TLSF::alloc(allocator, 16, 8);
+    int* moved = (int*) TLSF::realloc(allocator, grown, sizeof(int) * 200);
+    assert(moved != nullptr && moved != grown);
+    for (int i = 0; i < 10; i++) assert(moved[i] == i);
+
+    // shrink keeps the pointer
+    assert(TLSF::realloc(allocator, moved, sizeof(int) * 4) == moved);
+
+    // sizes that would wrap when rounded are refused, the block stays as it was
+    assert(TLSF::alloc(allocator, SIZE_MAX, 8) == nullptr);
+    assert(TLSF::alloc(allocator, SIZE_MAX - 4, 8) == nullptr);
+    assert(TLSF::alloc(allocator, 16, (size_t)1 << 62) == nullptr);
+    assert(TLSF::realloc(allocator, moved, SIZE_MAX - 4) == nullptr);
+    for (int i = 0; i < 4; i++) assert(moved[i] == i);
+    assert(TLSF::realloc(allocator, moved, sizeof(int) * 4) == moved);
+
+    TLSF::free(allocator, moved);
+    TLSF::free(allocator, blocker);
+    TLSF::destroy(allocator);
+}
+
+TEST(test_pool_basic) {
+    Pool::Allocator pool;
+    assert(Pool::init(pool, 24, 4));
+
+    void* slots[4];
+    for (int i = 0; i < 4; i++) {
+        slots[i] = Pool::alloc(pool);
+        assert(slots[i] != nullptr);
+        assert((uintptr_t)slots[i] % MIN_ALIGNMENT == 0);
+    }
+    // slots are packed back to back, no header in between
+    assert((uint8_t*)slots[1] - (uint8_t*)slots[0] == 24);
+
+    assert(Pool::alloc(pool) == nullptr);
+    assert(Pool::getUsed(pool) == 4 && Pool::getAvailable(pool) == 0);
+
+    // LIFO reuse
+    Pool::free(pool, slots[2]);
+    assert(Pool::alloc(pool) == slots[2]);
+
+    for (int i = 0; i < 4; i++) Pool::free(pool, slots[i]);
+    assert(Pool::getUsed(pool) == 0);
+
+    Pool::destroy(pool);
+}
+
+TEST(test_pool_refill_and_batch) {
+    Pool::Allocator pool;
+    assert(Pool::init(pool, 32, 0, 16));
+    assert(Pool::alloc(pool) == nullptr);
+
+    alignas(16) uint8_t chunk[32 * 8];
+    assert(Pool::refill(pool, chunk, sizeof(chunk)) == 8);
+
+    void* batch[10];
+    assert(Pool::alloc_batch(pool, batch, 10) == 8);
+    for (int i = 0; i < 8; i++) {
+        assert((uintptr_t)batch[i] % 16 == 0);
+        assert((uint8_t*)batch[i] >= chunk && (uint8_t*)batch[i] < chunk + sizeof(chunk));
+    }
+
+    Pool::free_batch(pool, batch, 8);
+    assert(Pool::getUsed(pool) == 0 && Pool::getAvailable(pool) == 8);
+
+    // mixes recycled and fresh slots after another refill
+    alignas(16) uint8_t more[32 * 4];
+    assert(Pool::refill(pool, more, sizeof(more)) == 4);
+    assert(Pool::alloc_batch(pool, batch, 10) == 10);
+    assert(Pool::getAvailable(pool) == 2);
+
+    Pool::destroy(pool);
+}
+
+TEST(test_linear_fixed) {
+    Linear::Allocator allocator;
+    assert(Linear::init(allocator, 256));
+
+    void* p1 = Linear::alloc(allocator, 64, 8);
+    void* p2 = Linear::alloc(allocator, 64, 32);
+    assert(p1 != nullptr && p2 != nullptr);
+    assert((uintptr_t)p2 % 32 == 0);
+
+    // a fixed arena just runs out
+    assert(Linear::alloc(allocator, 256, 8) == nullptr);
+
+    Linear::reset(allocator);
+    assert(Linear::getUsed(allocator) == 0 && Linear::getAvailable(allocator) == 256);
+    assert(Linear::alloc(allocator, 64, 8) == p1);
+
+    Linear::destroy(allocator);
+}
+
+TEST(test_linear_chained) {
+    Linear::Options linear_options;
+    linear_options.growable = true;
+
+    Linear::Allocator allocator;
+    assert(Linear::init(allocator, 256, linear_options));
+
+    std::vector<void*> first_pass;
+    for (int i = 0; i < 64; i++) {
+        void* p = Linear::alloc(allocator, 40, 8);
+        assert(p != nullptr);
+        std::memset(p, i, 40);
+        first_pass.push_back(p);
+    }
+    // data in earlier chunks is untouched by growth
+    for (int i = 0; i < 64; i++) assert(((uint8_t*)first_pass[i])[39] == i);
+
+    // no headers, allocations sit back to back: 64 * 40 bytes summed across every chunk
+    assert((uint8_t*)first_pass[1] == (uint8_t*)first_pass[0] + 40);
+    assert(Linear::getUsed(allocator) == 64 * 40);
+
+    // a request bigger than any chunk so far still fits
+    void* big = Linear::alloc(allocator, 100000, 64);
+    assert(big != nullptr && (uintptr_t)big % 64 == 0);
+
+    // reset rewinds to the first chunk and keeps the rest cached
+    Linear::Chunk* first = allocator.first;
+    size_t cached = Linear::getAvailable(allocator);
+    Linear::reset(allocator);
+    assert(allocator.current == first && Linear::getUsed(allocator) == 0);
+    assert(Linear::getAvailable(allocator) > cached);
+
+    // the same pattern reuses the cached chunks, same addresses
+    for (int i = 0; i < 64; i++) {
+        assert(Linear::alloc(allocator, 40, 8) == first_pass[i]);
+    }
+
+    Linear::destroy(allocator);
+}
+
+TEST(test_linear_markers) {
+    Linear::Options linear_options;
+    linear_options.growable = true;
+    linear_options.headers = true; // for the LIFO free below
+
+    Linear::Allocator allocator;
+    assert(Linear::init(allocator, 512, linear_options));
+
+    void* persistent = Linear::alloc(allocator, 32, 8);
+    Linear::Marker outer = Linear::getMarker(allocator);
+    size_t used_at_outer = Linear::getUsed(allocator);
+
+    {
+        Linear::ScopedArena scope(allocator);
+        Linear::alloc(allocator, 100, 8);
+        {
+            Linear::ScopedArena inner(allocator);
+            // spills into a second chunk
+            for (int i = 0; i < 20; i++) assert(Linear::alloc(allocator, 64, 16) != nullptr);
+            assert(allocator.current != allocator.first);
+        }
+        // inner scope gone, back in the first chunk
+        assert(allocator.current == allocator.first);
+        assert(Linear::getUsed(allocator) == used_at_outer + sizeof(AllocationHeader) + 100);
+    }
+    assert(Linear::getUsed(allocator) == used_at_outer);
+
+    // rollback to an explicit marker
+    Linear::alloc(allocator, 64, 8);
+    Linear::rollbackTo(allocator, outer);
+    assert(Linear::getUsed(allocator) == used_at_outer);
+
+    // LIFO free pops the most recent allocation, padding included
+    void* a = Linear::alloc(allocator, 24, 8);
+    void* b = Linear::alloc(allocator, 24, 64);
+    Linear::free(allocator, a); // not the top, ignored
+    assert(Linear::alloc(allocator, 8, 8) != a);
+    Linear::rollbackTo(allocator, outer);
+
+    a = Linear::alloc(allocator, 24, 8);
+    b = Linear::alloc(allocator, 24, 64);
+    Linear::free(allocator, b);
+    assert(Linear::alloc(allocator, 24, 64) == b);
+    Linear::free(allocator, b);
+    Linear::free(allocator, a);
+    assert(Linear::getUsed(allocator) == used_at_outer);
+
+    assert(persistent != nullptr);
+    Linear::destroy(allocator);
+}
+
+TEST(test_linear_stats) {
+    Linear::Options linear_options;
+    linear_options.growable = true;
+
+    Linear::Allocator allocator;
+    assert(Linear::init(allocator, 256, linear_options));
+
+    for (int i = 0; i < 20; i++) Linear::alloc(allocator, 64, 8);
+    Linear::Stats stats = Linear::getStats(allocator);
+    assert(stats.bytes_in_use == 20 * 64);
+    assert(stats.chunk_count > 1 && stats.reserved_bytes >= stats.bytes_in_use);
+
+    // the high-water mark survives the reset
+    Linear::reset(allocator);
+    Linear::alloc(allocator, 64, 8);
+    stats = Linear::getStats(allocator);
+    assert(stats.bytes_in_use == 64);
+#ifdef ALLOC_STATS
+    assert(stats.counters.peak_bytes_in_use == 20 * 64);
+    assert(stats.counters.alloc_count == 21 && stats.counters.reset_count == 1);
+#endif
+
+    Linear::destroy(allocator);
+}
+
+TEST(test_linear_mmap_trim) {
+    const size_t SIZE = 1024 * 1024;
+    Linear::Options linear_options;
+    linear_options.growable = true;
+    linear_options.mmap_backed = true;
+
+    Linear::Allocator allocator;
+    assert(Linear::init(allocator, SIZE, linear_options));
+
+    // spill into a second chunk and touch everything
+    for (int i = 0; i < 3; i++) {
+        void* p = Linear::alloc(allocator, SIZE / 2, 64);
+        assert(p != nullptr);
+        std::memset(p, 1, SIZE / 2);
+    }
+    assert(Linear::getStats(allocator).chunk_count == 2);
+
+    Linear::reset(allocator);
+    size_t trimmed = Linear::trim(allocator);
+    assert(trimmed >= Linear::getStats(allocator).reserved_bytes - 2 * Pages::page_size());
+    assert(resident_pages(allocator.memory, allocator.capacity) <= 1);
+
+    // the arena works as before
+    char* p = (char*) Linear::alloc(allocator, SIZE / 2, 64);
+    assert(p != nullptr && p[SIZE / 4] == 0);
+
+    Linear::destroy(allocator);
+}
+
+TEST(test_linear_double_ended) {
+    const size_t SIZE = 4096;
+    Linear::DoubleEnded allocator;
+    assert(Linear::init(allocator, SIZE));
+
+    uint8_t* persistent = (uint8_t*) Linear::alloc(allocator, 100, 8);
+    uint8_t* scratch = (uint8_t*) Linear::alloc(allocator, 100, 64, Linear::End::High);
+    assert(persistent == allocator.memory);
+    assert(scratch != nullptr && (uintptr_t) scratch % 64 == 0);
+    assert(scratch + 100 <= (uint8_t*) allocator.memory + SIZE && scratch > persistent + 100);
+    std::memset(persistent, 1, 100);
+    std::memset(scratch, 2, 100);
+
+    // scratch comes and goes without touching the low end
+    size_t high_marker = Linear::getMarker(allocator, Linear::End::High);
+    {
+        Linear::ScopedEnd scope(allocator, Linear::End::High);
+        assert(Linear::alloc(allocator, 1000, 8, Linear::End::High) != nullptr);
+        assert(Linear::getUsed(allocator, Linear::End::High) > 1000);
+    }
+    assert(Linear::getMarker(allocator, Linear::End::High) == high_marker);
+
+    // the ends meet in the middle
+    size_t available = Linear::getAvailable(allocator);
+    assert(Linear::alloc(allocator, available + 1, 8) == nullptr);
+    assert(Linear::alloc(allocator, available + 1, 8, Linear::End::High) == nullptr);
+    void* low_rest = Linear::alloc(allocator, available / 2, 8);
+    void* high_rest = Linear::alloc(allocator, Linear::getAvailable(allocator) - 8, 8, Linear::End::High);
+    assert(low_rest != nullptr && high_rest != nullptr);
+    assert((uint8_t*) low_rest + available / 2 <= (uint8_t*) high_rest);
+
+    Linear::reset(allocator, Linear::End::High);
+    assert(Linear::getUsed(allocator, Linear::End::High) == 0);
+    for (int i = 0; i < 100; i++) assert(persistent[i] == 1);
+
+    size_t low_marker = Linear::getMarker(allocator, Linear::End::Low);
+    Linear::alloc(allocator, 64, 8);
+    Linear::rollbackTo(allocator, Linear::End::Low, low_marker);
+    assert(Linear::getUsed(allocator, Linear::End::Low) == low_marker);
+
+    Linear::reset(allocator);
+    assert(Linear::getAvailable(allocator) == SIZE);
+
+    Linear::destroy(allocator);
+}
+
+TEST(test_concurrent_linear) {
+    const size_t SIZE = 1024 * 1024;
+    ConcurrentLinear::Allocator allocator;
+    assert(ConcurrentLinear::init(allocator, SIZE));
+
+    {
+        ConcurrentLinear::Participant participant(allocator);
+
+        // small alignments take the fetch_add path, sizes are rounded so the offset stays aligned
+        uint8_t* a = (uint8_t*) ConcurrentLinear::alloc(allocator, 3, 8);
+        uint8_t* b = (uint8_t*) ConcurrentLinear::alloc(allocator, 8, 8);
+        assert(a != nullptr && b == a + MIN_ALIGNMENT);
+
+        // stricter ones the CAS path
+        void* c = ConcurrentLinear::alloc(allocator, 100, 256);
+        assert(c != nullptr && (uintptr_t) c % 256 == 0);
+
+        // reset is refused while anyone is inside
+        assert(!ConcurrentLinear::reset(allocator));
+
+        ConcurrentLinear::LocalArena local;
+        ConcurrentLinear::attach(local, allocator, 4096);
+        uint8_t* first = (uint8_t*) ConcurrentLinear::alloc(local, 24, 8);
+        uint8_t* second = (uint8_t*) ConcurrentLinear::alloc(local, 24, 8);
+        assert(first != nullptr && second == first + 24);
+        // one claim so far, taken from the shared offset
+        assert(ConcurrentLinear::getUsed(allocator) >= 4096 && ConcurrentLinear::getUsed(allocator) < 4096 + 512);
+
+        // too big for a sub-chunk, comes straight from the shared offset
+        uint8_t* big = (uint8_t*) ConcurrentLinear::alloc(local, 2048, 8);
+        assert(big != nullptr && (big < first || big >= first + 4096));
+
+        // the rest of the arena, then nothing
+        assert(ConcurrentLinear::alloc(allocator, ConcurrentLinear::getAvailable(allocator), 8) != nullptr);
+        assert(ConcurrentLinear::alloc(allocator, 8, 8) == nullptr);
+        assert(ConcurrentLinear::alloc(allocator, 8, 64) == nullptr);
+    }
+
+    assert(ConcurrentLinear::reset(allocator));
+    assert(ConcurrentLinear::getUsed(allocator) == 0);
+
+    // a local arena that outlives a reset drops the sub-chunk it claimed before it
+    ConcurrentLinear::LocalArena local;
+    ConcurrentLinear::attach(local, allocator, 4096);
+    {
+        ConcurrentLinear::Participant participant(allocator);
+        assert(ConcurrentLinear::alloc(local, 16, 8) != nullptr);
+        assert(ConcurrentLinear::alloc(allocator, 64 * 1024, 8) != nullptr);
+    }
+    assert(ConcurrentLinear::reset(allocator));
+    {
+        ConcurrentLinear::Participant participant(allocator);
+        uint8_t* p = (uint8_t*) ConcurrentLinear::alloc(local, 16, 8);
+        assert(p != nullptr && p < (uint8_t*) allocator.memory + ConcurrentLinear::CLAIM_ALIGNMENT);
+    }
+
+    ConcurrentLinear::destroy(allocator);
+}
+
 int main() {
 
     std::cout << "------unit tests-------" << std::endl;
 
-    RUN_TEST(test_basic);
-    RUN_TEST(test_alignment);
-    RUN_TEST(test_coalescence);
-    RUN_TEST(test_realloc_growth);
-    RUN_TEST(test_realloc_shrink_alignment_safety);
+    for (FreeList::FitPolicy p : {FreeList::FitPolicy::FirstFit, FreeList::FitPolicy::Segregated,
+                                  FreeList::FitPolicy::BestFit, FreeList::FitPolicy::AddressOrderedBestFit})
+    for (bool compact : {false, true}) {
+        options.policy = p;
+        options.compact_headers = compact;
+        std::cout << "--- policy " << (int)options.policy << (compact ? " compact" : "") << " ---" << std::endl;
+
+        RUN_TEST(test_basic);
+        RUN_TEST(test_alignment);
+        RUN_TEST(test_coalescence);
+        RUN_TEST(test_realloc_growth);
+        RUN_TEST(test_realloc_in_place);
+        RUN_TEST(test_realloc_shrink_alignment_safety);
+        RUN_TEST(test_boundary_tag_merge);
+        RUN_TEST(test_freelist_stats);
+        RUN_TEST(test_freelist_mmap_trim);
+        RUN_TEST(test_freelist_calloc);
+        RUN_TEST(test_freelist_realloc_move);
+        RUN_TEST(test_freelist_growth);
+        RUN_TEST(test_freelist_owns_regions);
+        RUN_TEST(test_freelist_huge_sizes);
+        RUN_TEST(test_freelist_batch);
+        RUN_TEST(test_freelist_sized_free);
+        RUN_TEST(test_freelist_front_cache);
+    }
+
+    RUN_TEST(test_compact_headers);
+    RUN_TEST(test_segregated_reuses_hole);
+    RUN_TEST(test_segregated_constant_time);
+    RUN_TEST(test_best_fit_policies);
+    RUN_TEST(test_best_fit_trim);
+
+    RUN_TEST(test_basic_freelist);
+    RUN_TEST(test_basic_arena);
+
+    RUN_TEST(test_tlsf_basic);
+    RUN_TEST(test_tlsf_alignment);
+    RUN_TEST(test_tlsf_realloc);
+
+    RUN_TEST(test_linear_fixed);
+    RUN_TEST(test_linear_chained);
+    RUN_TEST(test_linear_markers);
+    RUN_TEST(test_linear_stats);
+    RUN_TEST(test_linear_mmap_trim);
+    RUN_TEST(test_linear_double_ended);
+    RUN_TEST(test_concurrent_linear);
+
+    RUN_TEST(test_pool_basic);
+    RUN_TEST(test_pool_refill_and_batch);
 
     return 0;
 }